@@ -0,0 +1,193 @@
+/*
+ * Definitions for the extensions to Phase 2. phase2.h and phase2Int.h are the course's
+ * own and are left as they are; everything added on top of them is here.
+ */
+
+#ifndef _PHASE2_EXT_H
+#define _PHASE2_EXT_H
+
+#include "phase2Int.h"
+
+// Phase 2b
+
+extern  int     P2_SleepMicros(int us) CHECKRETURN;
+extern  int     P2_SleepUntil(int absoluteUs) CHECKRETURN;
+extern  int     P2_SleepStats(int *count, int *averageLateness, int *worstLateness) CHECKRETURN;
+
+#define P2_MAX_TIMERS           128 // most timers P2_TimerCreate can have pending
+
+extern  int     P2_TimerCreate(int deadlineUs, void (*callback)(void *arg), void *arg,
+                               int *timer) CHECKRETURN;
+extern  int     P2_TimerCancel(int timer) CHECKRETURN;
+
+// Phase 2c
+
+extern  int     P2_DiskFlush(int unit) CHECKRETURN;
+
+/*
+ * Per-unit disk statistics returned by P2_DiskStats. Histogram bucket i counts requests
+ * that took from 2^i up to 2^(i+1) microseconds; bucket 0 also counts 0 and the last
+ * bucket everything longer.
+ */
+#define P2_DISK_HIST_BUCKETS    24
+
+typedef struct P2_DiskStatistics {
+    int     reads, writes, flushes;         // requests completed
+    int     sectorsRead, sectorsWritten;
+    int     seeks;                          // seeks sent to the device
+    int     queueDepth, maxQueueDepth;      // requests waiting for the driver
+    int     expiredReads, expiredWrites;    // served early by the deadline policy
+    int     queueWait[P2_DISK_HIST_BUCKETS];// submit to dispatch
+    int     service[P2_DISK_HIST_BUCKETS];  // dispatch to completion
+    int     latency[P2_DISK_HIST_BUCKETS];  // submit to completion
+} P2_DiskStatistics;
+
+extern  int     P2_DiskStats(int unit, P2_DiskStatistics *info) CHECKRETURN;
+extern  int     P2_DiskSeekStats(int unit, int *issued, int *elided, int *traveled) CHECKRETURN;
+extern  int     P2_DiskCacheStats(int *hits, int *misses, int *evictions) CHECKRETURN;
+extern  int     P2_DiskPrefetchStats(int *issued, int *hits, int *wasted) CHECKRETURN;
+
+#define P2_DISK_MAX_WEIGHT      16
+
+extern  int     P2_DiskSetWeight(int pid, int weight) CHECKRETURN;
+
+/*
+ * One finished request in the disk request trace, see P2_DiskTraceRead. time is when it
+ * was submitted and latency how long it took to finish, both in microseconds.
+ */
+typedef struct P2_DiskTraceEntry {
+    int     time, pid, unit, type;  // type is USLOSS_DISK_READ or USLOSS_DISK_WRITE
+    int     track, first, sectors;
+    int     latency;
+} P2_DiskTraceEntry;
+
+extern  int     P2_DiskTraceRead(P2_DiskTraceEntry *entries, int max, int *count) CHECKRETURN;
+extern  void    P2_DiskTraceDump(void);
+
+#define P2_DISK_MAX_ASYNC       16  // uncollected asynchronous requests per process and unit
+#define P2_DISK_MAX_ASYNC_UNIT  24  // uncollected asynchronous requests per unit, all processes
+
+extern  int     P2_DiskReadAsync(int unit, int track, int first, int sectors, void *buffer,
+                                 int *handle) CHECKRETURN;
+extern  int     P2_DiskWriteAsync(int unit, int track, int first, int sectors, void *buffer,
+                                  int *handle) CHECKRETURN;
+extern  int     P2_DiskWait(int handle) CHECKRETURN;
+extern  int     P2_DiskWaitAny(int *handles, int n) CHECKRETURN;
+extern  int     P2_DiskCancel(int handle) CHECKRETURN;
+extern  int     P2_DiskSetTimeout(int us) CHECKRETURN;
+
+/*
+ * One extent of a vectored disk request.
+ */
+typedef struct P2_DiskSegment {
+    int     track;
+    int     first;
+    int     sectors;
+    void    *buffer;
+} P2_DiskSegment;
+
+#define P2_DISK_MAX_SEGMENTS    32
+
+extern  int     P2_DiskReadV(int unit, P2_DiskSegment *segments, int count, int *status) CHECKRETURN;
+extern  int     P2_DiskWriteV(int unit, P2_DiskSegment *segments, int count, int *status) CHECKRETURN;
+
+/*
+ * Striped virtual disk across all disk units, addressed by logical sector.
+ */
+extern  int     P2_StripeRead(int sector, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_StripeWrite(int sector, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_StripeSize(int *sectors, int *stripe) CHECKRETURN;
+
+/*
+ * Mirrored virtual disk on two disk units, addressed like a single unit.
+ */
+extern  int     P2_MirrorRead(int track, int first, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_MirrorWrite(int track, int first, int sectors, void *buffer) CHECKRETURN;
+extern  int     P2_MirrorStats(int *tracks, int *primaryReads, int *secondaryReads) CHECKRETURN;
+
+/*
+ * Contiguous extent allocation on a disk unit. The allocator keeps its free-space bitmap
+ * in the first sectors of the unit and claims them the first time the unit is used.
+ */
+extern  int     P2_DiskAlloc(int unit, int sectors, int *track, int *first) CHECKRETURN;
+extern  int     P2_DiskFree(int unit, int track, int first, int sectors) CHECKRETURN;
+
+/*
+ * Byte-addressed reads and writes, offset counted in bytes from the start of the unit.
+ */
+extern  int     P2_DiskPread(int unit, int offset, int len, void *buffer) CHECKRETURN;
+extern  int     P2_DiskPwrite(int unit, int offset, int len, void *buffer) CHECKRETURN;
+
+extern  int     P2_DiskCopy(int srcUnit, int srcTrack, int srcFirst, int dstUnit, int dstTrack,
+                            int dstFirst, int sectors) CHECKRETURN;
+extern  int     P2_DiskFill(int unit, int track, int first, int sectors, void *pattern) CHECKRETURN;
+
+/*
+ * Error codes for the Phase 2 extensions. They follow the ones in phase2.h.
+ */
+
+#define P2_INVALID_POLICY       -26
+#define P2_INVALID_HANDLE       -27
+#define P2_INVALID_WEIGHT       -28
+#define P2_NO_SPACE             -29
+#define P2_CANCELLED            -30
+#define P2_TIMED_OUT            -31
+#define P2_NO_TIMERS            -32
+#define P2_TOO_MANY_REQUESTS    -33
+
+/*
+ * System call numbers for the Phase 2 extensions. They follow the ones in usyscall.h.
+ */
+
+#define SYS_DISKREADASYNC       30
+#define SYS_DISKWRITEASYNC      31
+#define SYS_DISKWAIT            32
+#define SYS_DISKWAITANY         33
+#define SYS_DISKREADV           34
+#define SYS_DISKWRITEV          35
+#define SYS_DISKFLUSH           36
+#define SYS_DISKSTATS           37
+#define SYS_DISKSETWEIGHT       38
+#define SYS_DISKALLOC           39
+#define SYS_DISKFREE            40
+#define SYS_DISKPREAD           41
+#define SYS_DISKPWRITE          42
+#define SYS_DISKCOPY            43
+#define SYS_DISKFILL            44
+#define SYS_DISKCANCEL          45
+#define SYS_DISKSETTIMEOUT      46
+#define SYS_SLEEPMICROS         47
+#define SYS_SLEEPUNTIL          48
+
+// Phase 2c internal
+
+#define P2_DISK_FIFO    0   // serve requests in arrival order
+#define P2_DISK_CLOOK   1   // C-LOOK elevator ordered by track
+#define P2_DISK_DEADLINE 2  // C-LOOK, but requests past their deadline go first
+#define P2_DISK_FAIR    3   // processes take turns, see P2_DiskSetWeight
+
+#define P2_DEADLINE_READ        100000  // default deadlines, in microseconds
+#define P2_DEADLINE_WRITE       1000000
+
+#define P2_DISK_QUANTUM         USLOSS_DISK_TRACK_SIZE  // fair policy sectors per turn and weight
+#define P2_DISK_WEIGHT_DEFAULT  1
+
+#define P2_DISK_TRACE_MAX       4096    // most entries the request trace can hold
+
+#define P2_DISK_CACHE_MAX       256 // most sectors the buffer cache can hold
+#define P2_DISK_CACHE_DEFAULT   64
+
+#define P2_READAHEAD_MIN        4   // read-ahead window bounds, in sectors
+#define P2_READAHEAD_MAX        32
+
+#define P2_STRIPE_DEFAULT       USLOSS_DISK_TRACK_SIZE  // striped disk stripe size, in sectors
+
+int     P2DiskSetScheduler(int unit, int policy);
+int     P2DiskSetDeadlines(int unit, int readUs, int writeUs);
+int     P2DiskSetCacheSize(int blocks);
+int     P2DiskSetWriteBack(int enable);
+int     P2DiskSetStripe(int sectors);
+int     P2DiskSetMirror(int primary, int secondary);
+int     P2DiskSetTrace(int entries);
+
+#endif
@@ -6,11 +6,15 @@
 #include <usloss.h>
 #include <phase1.h>
 #include <time.h>
-#include "phase2Int.h"
+#include "phase2Ext.h"
 
 
 static int      ClockDriver(void *);
 static void     SleepStub(USLOSS_Sysargs *sysargs);
+static void     SleepMicrosStub(USLOSS_Sysargs *sysargs);
+static void     SleepUntilStub(USLOSS_Sysargs *sysargs);
+static int      sleepUntil(int wakeup);
+static int      clockTime(void);
 static void 	checkIfIsKernel();
 // semaphores
 int mutex;
@@ -24,11 +28,115 @@ void V(int sid) {
 	assert(P1_V(sid) == P1_SUCCESS);
 }
 
-typedef struct p {
-    int pid, startTime, duration, sid, isActive;
-} Process; 
+typedef struct t {
+	int wakeup; // clock time, in microseconds, to run the callback at
+	void (*callback)(void *arg);
+	void *arg;
+	int index; // position in the heap
+	int generation; // bumped whenever the timer is freed, so stale handles are rejected
+	int sleeper; // TRUE if it belongs to a sleeping process, see sleepUntil
+	struct t *next; // next timer in the free list
+} Timer;
 
-Process processes[P1_MAXPROC];
+#define NUM_TIMERS (P1_MAXPROC + P2_MAX_TIMERS) // a sleeper can always get one
+#define MAX_GENERATION (0x7fffffff / NUM_TIMERS) // keeps handles non-negative
+
+Timer timers[NUM_TIMERS];
+Timer *freeTimers; // timers not in use
+int callouts; // timers in use by P2_TimerCreate
+Timer *heap[NUM_TIMERS]; // pending timers, a min-heap ordered by wakeup time
+int heapSize;
+
+typedef struct s {
+	int wakeup; // the same as its timer's, to tell how late it was woken
+	int sid;
+	struct s *next; // next sleeper in the free list
+} Sleeper;
+
+Sleeper sleepers[P1_MAXPROC];
+Sleeper *freeSleepers; // sleepers not in use
+int tickTime; // time of the clock interrupt whose timers the driver is running
+
+// how late sleepers were woken, in microseconds past their wakeup time
+int wakeups;
+long long lateTotal;
+int lateWorst;
+
+// returns TRUE if timer a is due before b, comparing differences so the clock may wrap
+static int earlier(Timer *a, Timer *b) {
+	return a->wakeup - b->wakeup < 0;
+}
+
+// puts a timer at position i of the heap
+static void heapSet(int i, Timer *timer) {
+	heap[i] = timer;
+	timer->index = i;
+}
+
+// moves the timer at position i towards the root until its parent is due first
+static void siftUp(int i) {
+	Timer *timer = heap[i];
+	while (i > 0 && earlier(timer, heap[(i - 1) / 2])) {
+		heapSet(i, heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	heapSet(i, timer);
+}
+
+// moves the timer at position i towards the leaves until its children are due after it
+static void siftDown(int i) {
+	Timer *timer = heap[i];
+	while (2 * i + 1 < heapSize) {
+		int child = 2 * i + 1;
+		if (child + 1 < heapSize && earlier(heap[child + 1], heap[child])) child++;
+		if (!earlier(heap[child], timer)) break;
+		heapSet(i, heap[child]);
+		i = child;
+	}
+	heapSet(i, timer);
+}
+
+// adds a timer to the heap
+static void heapPush(Timer *timer) {
+	heapSet(heapSize++, timer);
+	siftUp(heapSize - 1);
+}
+
+// takes the timer at position i out of the heap
+static void heapRemove(int i) {
+	Timer *last = heap[--heapSize];
+	if (i == heapSize) return;
+	heapSet(i, last);
+	siftUp(i);
+	siftDown(last->index);
+}
+
+// takes a timer from the free list and queues it, mutex must be held
+static Timer *timerStart(int wakeup, void (*callback)(void *arg), void *arg, int sleeper) {
+	Timer *timer = freeTimers;
+	assert(timer != NULL);
+	freeTimers = timer->next;
+	timer->wakeup = wakeup;
+	timer->callback = callback;
+	timer->arg = arg;
+	timer->sleeper = sleeper;
+	if (!sleeper) callouts++;
+	heapPush(timer);
+	return timer;
+}
+
+// returns a timer that is no longer queued to the free list, mutex must be held
+static void timerFree(Timer *timer) {
+	timer->generation = (timer->generation + 1) % MAX_GENERATION;
+	if (!timer->sleeper) callouts--;
+	timer->next = freeTimers;
+	freeTimers = timer;
+}
+
+// handles encode the timer's slot and generation so stale handles are rejected
+static int timerToHandle(Timer *timer) {
+	return timer->generation * NUM_TIMERS + (timer - timers);
+}
 
 /*
  * P2ClockInit
@@ -45,15 +153,32 @@ P2ClockInit(void)
 	rc = P1_SemCreate("mutex", 1, &mutex);
 	assert(rc == P1_SUCCESS);
     // initialize data structures here
-	for (int i = 0; i < P1_MAXPROC; i++) {
+	freeSleepers = NULL;
+	for (int i = P1_MAXPROC - 1; i >= 0; i--) {
 		char name[20];
 		sprintf(name, "%d", i);
-		rc = P1_SemCreate(name, 0, &processes[i].sid);
+		rc = P1_SemCreate(name, 0, &sleepers[i].sid);
 		assert(rc == P1_SUCCESS);
-		processes[i].isActive = FALSE;
-	}		
+		sleepers[i].next = freeSleepers;
+		freeSleepers = &sleepers[i];
+	}
+	freeTimers = NULL;
+	for (int i = NUM_TIMERS - 1; i >= 0; i--) {
+		timers[i].generation = 0;
+		timers[i].next = freeTimers;
+		freeTimers = &timers[i];
+	}
+	callouts = 0;
+	heapSize = 0;
+	wakeups = 0;
+	lateTotal = 0;
+	lateWorst = 0;
 
     rc = P2_SetSyscallHandler(SYS_SLEEP, SleepStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SLEEPMICROS, SleepMicrosStub);
+    assert(rc == P1_SUCCESS);
+    rc = P2_SetSyscallHandler(SYS_SLEEPUNTIL, SleepUntilStub);
     assert(rc == P1_SUCCESS);
 
 	int pid;
@@ -82,7 +207,10 @@ P2ClockShutdown(void)
 /*
  * ClockDriver
  *
- * Kernel process that manages the clock device and wakes sleeping processes.
+ * Kernel process that manages the clock device and runs timers, which wake sleeping
+ * processes among other things. The timers are kept in a heap by wakeup time, so each
+ * tick only looks at the ones that are due. A timer is freed before its callback runs,
+ * and the callback runs without the mutex held, so it may start new timers.
  */
 static int 
 ClockDriver(void *arg) 
@@ -91,23 +219,25 @@ ClockDriver(void *arg)
         int rc;
         int now;
 
-        // wait for the next interrupt
+        // wait for the next interrupt, the clock's status is the current time
         rc = P1_WaitDevice(USLOSS_CLOCK_DEV, 0, &now);
         if (rc == P1_WAIT_ABORTED) {
             break;
         }
         assert(rc == P1_SUCCESS);
 		
-        // wakeup any sleeping processes whose wakeup time has arrived
+        // run the timers whose wakeup time has arrived
 		P(mutex);
-		for (int i = 0; i < P1_MAXPROC; i++) {
-			if (processes[i].isActive) {
-				int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
-				assert(rc == USLOSS_DEV_OK);
-				if (processes[i].duration*1000000 <= now - processes[i].startTime) {
-					V(processes[i].sid);
-				}
-			}
+		tickTime = now;
+		while (heapSize > 0 && heap[0]->wakeup - now <= 0) {
+			Timer *timer = heap[0];
+			void (*callback)(void *arg) = timer->callback;
+			void *arg = timer->arg;
+			heapRemove(0);
+			timerFree(timer);
+			V(mutex);
+			callback(arg);
+			P(mutex);
 		}
 		V(mutex);
     }
@@ -124,29 +254,147 @@ P2_Sleep(int seconds)
 {
 	checkIfIsKernel();
 	if (seconds < 0) return P2_INVALID_SECONDS;
-	
-    // add current process to data structure of sleepers
-	int i;
+	return sleepUntil(clockTime() + seconds*1000000);
+}
+
+/*
+ * P2_SleepMicros
+ *
+ * Causes the current process to sleep for at least the specified number of
+ * microseconds. It is woken by the first clock interrupt after that, so it may sleep up
+ * to a clock tick longer.
+ */
+int
+P2_SleepMicros(int us)
+{
+	checkIfIsKernel();
+	if (us < 0) return P2_INVALID_SECONDS;
+	return sleepUntil(clockTime() + us);
+}
+
+/*
+ * P2_SleepUntil
+ *
+ * Causes the current process to sleep until the clock reaches the specified time, in
+ * microseconds, woken by the first clock interrupt at or after it. Returns at once if
+ * that time has already passed.
+ */
+int
+P2_SleepUntil(int absoluteUs)
+{
+	checkIfIsKernel();
+	if (absoluteUs < 0) return P2_INVALID_SECONDS;
+	if (absoluteUs - clockTime() <= 0) return P1_SUCCESS;
+	return sleepUntil(absoluteUs);
+}
+
+/*
+ * P2_SleepStats
+ *
+ * Returns how many sleeps have ended, and the average and worst time in microseconds
+ * between a sleeper's wakeup time and the clock interrupt that woke it.
+ */
+int
+P2_SleepStats(int *count, int *averageLateness, int *worstLateness)
+{
+	checkIfIsKernel();
+	if (count == NULL || averageLateness == NULL || worstLateness == NULL) return P2_NULL_ADDRESS;
 	P(mutex);
-	for (i = 0; i < P1_MAXPROC; i++) {
-		if (!processes[i].isActive) break;
-	}
-	assert(i != P1_MAXPROC);
-	processes[i].isActive = TRUE;
+	*count = wakeups;
+	*averageLateness = wakeups > 0 ? lateTotal / wakeups : 0;
+	*worstLateness = lateWorst;
+	V(mutex);
+	return P1_SUCCESS;
+}
+
+// returns the current clock time, in microseconds
+static int clockTime(void) {
 	int now;
 	int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
 	assert(rc == USLOSS_DEV_OK);
-	processes[i].startTime = now;
-	processes[i].duration = seconds;
+	return now;
+}
+
+// timer callback that wakes a sleeping process and records how late it is
+static void wakeSleeper(void *arg) {
+	Sleeper *sleeper = (Sleeper *) arg;
+	int late = tickTime - sleeper->wakeup;
+	P(mutex);
+	wakeups++;
+	lateTotal += late;
+	if (late > lateWorst) lateWorst = late;
+	V(mutex);
+	V(sleeper->sid);
+}
+
+// puts the current process to sleep until the clock interrupt at or after wakeup
+static int sleepUntil(int wakeup) {
+    // add current process to data structure of sleepers
+	P(mutex);
+	Sleeper *sleeper = freeSleepers;
+	assert(sleeper != NULL);
+	freeSleepers = sleeper->next;
+	sleeper->wakeup = wakeup;
+	timerStart(wakeup, wakeSleeper, sleeper, TRUE);
 	V(mutex);
     // wait until sleep is complete
-	P(processes[i].sid);
+	P(sleeper->sid);
+	// the sleeper is only reused once its semaphore has been consumed
 	P(mutex);
-	processes[i].isActive = FALSE;
+	sleeper->next = freeSleepers;
+	freeSleepers = sleeper;
     V(mutex);
 	return P1_SUCCESS;
 }
 
+/*
+ * P2_TimerCreate
+ *
+ * Starts a timer that calls callback(arg) from the clock driver at the first clock
+ * interrupt at or after deadlineUs, an absolute clock time in microseconds. The callback
+ * must not block; it may start and cancel timers. Returns a handle for P2_TimerCancel
+ * in *timer.
+ */
+int
+P2_TimerCreate(int deadlineUs, void (*callback)(void *arg), void *arg, int *timer)
+{
+	checkIfIsKernel();
+	if (callback == NULL || timer == NULL) return P2_NULL_ADDRESS;
+	if (deadlineUs < 0) return P2_INVALID_SECONDS;
+	P(mutex);
+	if (callouts == P2_MAX_TIMERS) {
+		V(mutex);
+		return P2_NO_TIMERS;
+	}
+	*timer = timerToHandle(timerStart(deadlineUs, callback, arg, FALSE));
+	V(mutex);
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_TimerCancel
+ *
+ * Stops a timer before its callback runs. Returns P2_INVALID_HANDLE if the handle is
+ * not a pending timer, including one whose callback has already been started.
+ */
+int
+P2_TimerCancel(int timer)
+{
+	checkIfIsKernel();
+	if (timer < 0) return P2_INVALID_HANDLE;
+	int rc = P2_INVALID_HANDLE;
+	P(mutex);
+	Timer *t = &timers[timer % NUM_TIMERS];
+	if (t->generation == timer / NUM_TIMERS && !t->sleeper && t->index < heapSize &&
+		heap[t->index] == t) {
+		heapRemove(t->index);
+		timerFree(t);
+		rc = P1_SUCCESS;
+	}
+	V(mutex);
+	return rc;
+}
+
 /*
  * SleepStub
  *
@@ -160,6 +408,20 @@ SleepStub(USLOSS_Sysargs *sysargs)
     sysargs->arg4 = (void *) rc;
 }
 
+// stub for P2_SleepMicros
+static void
+SleepMicrosStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_SleepMicros((int) sysargs->arg1);
+}
+
+// stub for P2_SleepUntil
+static void
+SleepUntilStub(USLOSS_Sysargs *sysargs)
+{
+    sysargs->arg4 = (void *) P2_SleepUntil((int) sysargs->arg1);
+}
+
 /*
  * Checks psr to make sure OS is in kernel mode, halting USLOSS if not. Mode bit
  * is the LSB.
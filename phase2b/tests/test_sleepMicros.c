@@ -0,0 +1,67 @@
+/*
+ * test_sleepMicros.c
+ *
+ * Sleeps for less than a second, relative and absolute, and checks the lateness
+ * statistics.
+ */
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define DELAY 50000
+
+static int passed = FALSE;
+
+static int Now(void) {
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, start, count, average, worst;
+
+    P2ClockInit();
+
+    start = Now();
+    rc = P2_SleepMicros(DELAY);
+    TEST(rc, P1_SUCCESS);
+    TEST(Now() - start >= DELAY, 1);
+
+    start = Now();
+    rc = P2_SleepUntil(start + DELAY);
+    TEST(rc, P1_SUCCESS);
+    TEST(Now() - start >= DELAY, 1);
+
+    // a time that has passed does not sleep at all
+    rc = P2_SleepUntil(start);
+    TEST(rc, P1_SUCCESS);
+
+    rc = P2_SleepStats(&count, &average, &worst);
+    TEST(rc, P1_SUCCESS);
+    TEST(count, 2);
+    TEST(average >= 0 && average <= worst, 1);
+
+    TEST(P2_SleepMicros(-1), P2_INVALID_SECONDS);
+    TEST(P2_SleepUntil(-1), P2_INVALID_SECONDS);
+    TEST(P2_SleepStats(NULL, &average, &worst), P2_NULL_ADDRESS);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
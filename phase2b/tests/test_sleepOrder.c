@@ -0,0 +1,61 @@
+/*
+ * test_sleepOrder.c
+ *
+ * Processes that go to sleep in one order must wake up in order of their wakeup times.
+ */
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Int.h"
+
+#define NUM_SLEEPERS 5
+
+static int passed = FALSE;
+
+static int durations[NUM_SLEEPERS] = {4, 1, 3, 0, 2};
+static int order[NUM_SLEEPERS];
+static int woken = 0;
+
+int Sleeper(void *arg) {
+    int id = (int) arg;
+    int rc = P2_Sleep(durations[id]);
+    assert(rc == P1_SUCCESS);
+    order[woken++] = id;
+    return 0;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, pid, status;
+
+    P2ClockInit();
+    for (i = 0; i < NUM_SLEEPERS; i++) {
+        rc = P1_Fork(MakeName("Sleeper", i), Sleeper, (void *) i, USLOSS_MIN_STACK, 3, 0, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < NUM_SLEEPERS; i++) {
+        rc = P1_Join(0, &pid, &status);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(woken, NUM_SLEEPERS);
+    for (i = 0; i < NUM_SLEEPERS; i++) {
+        TEST(durations[order[i]], i);
+    }
+    TEST(P2_Sleep(-1), P2_INVALID_SECONDS);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * test_timer.c
+ *
+ * Starts timers out of order, cancels one, and re-arms another from its own callback.
+ */
+#include <assert.h>
+#include <usloss.h>
+#include <stdlib.h>
+#include <libuser.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_TIMERS  3
+#define PERIOD      20000
+#define REPEATS     3
+
+static int passed = FALSE;
+
+static int delays[NUM_TIMERS] = {60000, 20000, 40000};
+static int order[NUM_TIMERS];
+static int fired = 0;
+static int ticks = 0;
+
+static int Now(void) {
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+static void Fire(void *arg) {
+    order[fired++] = (int) arg;
+}
+
+// runs every PERIOD microseconds until it has run REPEATS times
+static void Tick(void *arg) {
+    int timer;
+    if (++ticks < REPEATS) {
+        int rc = P2_TimerCreate(Now() + PERIOD, Tick, NULL, &timer);
+        assert(rc == P1_SUCCESS);
+    }
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, start, tick;
+    int handles[NUM_TIMERS];
+
+    P2ClockInit();
+
+    start = Now();
+    for (i = 0; i < NUM_TIMERS; i++) {
+        rc = P2_TimerCreate(start + delays[i], Fire, (void *) i, &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_TimerCreate(start + PERIOD, Tick, NULL, &tick);
+    TEST(rc, P1_SUCCESS);
+    // the 40ms timer never fires
+    rc = P2_TimerCancel(handles[2]);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2_TimerCancel(handles[2]), P2_INVALID_HANDLE);
+
+    rc = P2_SleepMicros(delays[0] + (REPEATS + 1) * PERIOD);
+    TEST(rc, P1_SUCCESS);
+    TEST(fired, 2);
+    TEST(order[0], 1);
+    TEST(order[1], 0);
+    TEST(ticks, REPEATS);
+    // a timer that has fired can no longer be cancelled
+    TEST(P2_TimerCancel(handles[0]), P2_INVALID_HANDLE);
+
+    TEST(P2_TimerCancel(-1), P2_INVALID_HANDLE);
+    TEST(P2_TimerCreate(start, NULL, NULL, &tick), P2_NULL_ADDRESS);
+    TEST(P2_TimerCreate(start, Fire, NULL, NULL), P2_NULL_ADDRESS);
+    TEST(P2_TimerCreate(-1, Fire, NULL, &tick), P2_INVALID_SECONDS);
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    // Do nothing.
+}
+
+void test_cleanup(int argc, char **argv) {
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
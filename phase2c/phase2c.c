@@ -6,32 +6,285 @@
 #include <usloss.h>
 #include <phase1.h>
 
-#include "phase2Int.h"
-#define QUEUE_SIZE (P1_MAXSEM/3)
+#include "phase2Ext.h"
+#define POOL_SIZE 32 // requests each unit can have outstanding
+#define MAX_GENERATION 10000
+#define DISK_FLUSH -1 // request type that writes back a unit's dirty sectors
 
 static int      DiskDriver(void *);
 static void     DiskReadStub(USLOSS_Sysargs *sysargs);
 static void	    DiskWriteStub(USLOSS_Sysargs *sysargs);
 static void     DiskSizeStub(USLOSS_Sysargs *sysargs);
+static void     DiskReadAsyncStub(USLOSS_Sysargs *sysargs);
+static void     DiskWriteAsyncStub(USLOSS_Sysargs *sysargs);
+static void     DiskWaitStub(USLOSS_Sysargs *sysargs);
+static void     DiskWaitAnyStub(USLOSS_Sysargs *sysargs);
+static void     DiskReadVStub(USLOSS_Sysargs *sysargs);
+static void     DiskWriteVStub(USLOSS_Sysargs *sysargs);
+static void     DiskFlushStub(USLOSS_Sysargs *sysargs);
+static void     DiskStatsStub(USLOSS_Sysargs *sysargs);
+static void     DiskSetWeightStub(USLOSS_Sysargs *sysargs);
+static void     DiskAllocStub(USLOSS_Sysargs *sysargs);
+static void     DiskFreeStub(USLOSS_Sysargs *sysargs);
+static void     DiskPreadStub(USLOSS_Sysargs *sysargs);
+static void     DiskPwriteStub(USLOSS_Sysargs *sysargs);
+static void     DiskCopyStub(USLOSS_Sysargs *sysargs);
+static void     DiskFillStub(USLOSS_Sysargs *sysargs);
+static void     DiskCancelStub(USLOSS_Sysargs *sysargs);
+static void     DiskSetTimeoutStub(USLOSS_Sysargs *sysargs);
 void checkIfIsKernel();
 void moveTrack(int track, int unit);
 void completeReadWriteAt(int type, int sector, int unit, void *buffer);
+static int      cacheRead(int unit, int track, int first, int sectors, void *buffer);
+static void     cacheStore(int unit, int track, int sector, void *data, int how);
+static int      cacheWrite(int unit, int track, int first, int sectors, void *buffer);
+static void     cacheOverwrite(int unit, int track, int first, int sectors, void *buffer);
+static void     flushDirty(int unit, int whenIdle);
+static int      cacheContains(int unit, int track, int sector);
+static void     readAhead(int unit, int start, int sectors, int hit);
+static void     prefetch(int unit);
 
 int NUM_TRACKS[USLOSS_DISK_UNITS];
 
 typedef struct r {
 	int type, track, first, sectors, succeeded;
 	void *buffer;
+	P2_DiskSegment *segments; // vectored requests only, NULL otherwise
+	int count, *status; // number of segments and their statuses
+	int unit;
+	int inUse, done;
+	int generation; // distinguishes handles that reuse this slot
+	int owner; // pid of the submitting process, the only one that may wait for it
+	int incarnation; // incarnations[owner] at submission, tells the owner from later users of the pid
+	int seq; // submission order on the unit, later writes win when merged writes overlap
+	int submitted, dispatched; // clock times, in microseconds
+	int deadline; // clock time by which the deadline policy wants it served
+	int timeout; // microseconds after submission it may take, 0 for no limit
+	int serving; // TRUE once the driver has taken it off the pending list
+	int started; // TRUE once the driver has planned a transfer for it
+	int cancelled; // set by P2_DiskCancel
+	int async; // TRUE if submitted by P2_DiskReadAsync or P2_DiskWriteAsync
+	int error; // P2_CANCELLED or P2_TIMED_OUT if it was stopped, P1_SUCCESS otherwise
+	struct r *origin; // for a segment being served, the vectored request it belongs to
+	struct r *next; // next request in the pending list or free list
 } Request;
 
-Request queue[USLOSS_DISK_UNITS][QUEUE_SIZE];
-int queueStarts[USLOSS_DISK_UNITS];
-int queueEnds[USLOSS_DISK_UNITS];
+// one planned device operation: a seek to track arg, or a transfer of sector arg of the
+// current track to or from data. sector is the transfer's sector counted from the start
+// of the unit.
+typedef struct op {
+	int opr, arg, sector;
+	void *data;
+} Operation;
+
+/*
+ * A disk scheduling policy. Every policy keeps all of a unit's pending requests on
+ * pending[unit], in whatever order suits it. enqueue adds a request, pickNext removes
+ * and returns the request the driver should serve next, remove takes out a request
+ * the driver is serving along with another one, and complete is called once the
+ * driver is done with a request. pickNext must pass over flushes that flushHeld says
+ * are still waiting for earlier writes. All hooks are called with mutex[unit] held.
+ */
+typedef struct s {
+	char *name;
+	void (*enqueue)(int unit, Request *request);
+	Request *(*pickNext)(int unit);
+	void (*remove)(int unit, Request *request);
+	void (*complete)(int unit, Request *request);
+} Scheduler;
+
+static void     fifoEnqueue(int unit, Request *request);
+static Request  *fifoPickNext(int unit);
+static void     clookEnqueue(int unit, Request *request);
+static Request  *clookPickNext(int unit);
+static void     deadlineEnqueue(int unit, Request *request);
+static Request  *deadlinePickNext(int unit);
+static Request  *fairPickNext(int unit);
+static void     fairRemove(int unit, Request *request);
+static void     fairComplete(int unit, Request *request);
+static void     listRemove(int unit, Request *request);
+static int      flushHeld(int unit, Request *request);
+static void     noComplete(int unit, Request *request);
+static void     finishRequest(Request *request);
+static void     releaseRequest(int unit, Request *request);
+static void     wakeOwner(Request *request);
+static void     recordRequest(Request *request, int completed);
+static void     traceRecord(Request *request, int track, int first, int sectors, int completed);
+static int      mergeAdjacent(int unit, Request **batch);
+static void     serveBatch(int unit, Request **batch, int n);
+static void     runOps(int unit, Operation *list, int n);
+static int      requestStopped(Request *request, int now);
+static void     dropStale(int unit);
+static void     dropRequest(int unit, Request *request, int error);
+static int      planSeek(int track, int unit);
+static void     serveVector(int unit, Request *request);
+
+// indexed by P2_DISK_FIFO, P2_DISK_CLOOK, ...
+static Scheduler schedulerTable[] = {
+	{"fifo", fifoEnqueue, fifoPickNext, listRemove, noComplete},
+	{"c-look", clookEnqueue, clookPickNext, listRemove, noComplete},
+	{"deadline", deadlineEnqueue, deadlinePickNext, listRemove, noComplete},
+	{"fair", fifoEnqueue, fairPickNext, fairRemove, fairComplete},
+};
+#define NUM_POLICIES (sizeof(schedulerTable) / sizeof(Scheduler))
+
+/*
+ * Each unit has a fixed pool of requests. A request holds its slot from submission
+ * until its owner collects the status, so an asynchronous request keeps its slot until
+ * P2_DiskWait. Submitters block on poolSlots[unit] while the pool is empty. Only the
+ * owner can free an asynchronous request's slot, so a process may hold at most
+ * P2_DISK_MAX_ASYNC of them per unit, and all processes together at most
+ * P2_DISK_MAX_ASYNC_UNIT. That is below POOL_SIZE, so the rest of the pool only holds
+ * requests the driver will finish and a synchronous submitter never waits for good.
+ */
+Request requests[USLOSS_DISK_UNITS][POOL_SIZE];
+Request *freeRequests[USLOSS_DISK_UNITS];
+Request *pending[USLOSS_DISK_UNITS];
+int policies[USLOSS_DISK_UNITS]; // set by P2DiskSetScheduler before P2DiskInit
+Scheduler *schedulers[USLOSS_DISK_UNITS];
+int headTrack[USLOSS_DISK_UNITS]; // track the head is on, -1 until the first seek
+int requestSeq[USLOSS_DISK_UNITS];
+// how long the deadline policy lets reads and writes wait, in microseconds
+int readDeadline[USLOSS_DISK_UNITS], writeDeadline[USLOSS_DISK_UNITS];
+int deadlinesSet[USLOSS_DISK_UNITS]; // TRUE for units P2DiskSetDeadlines configured
+// fair-share state: the process whose turn it is on each unit, the sectors each process
+// may still transfer this turn, and each process's weight (0 means P2_DISK_WEIGHT_DEFAULT)
+int fairTurn[USLOSS_DISK_UNITS];
+int fairCredit[P1_MAXPROC][USLOSS_DISK_UNITS];
+int diskWeights[P1_MAXPROC];
+
+// most pending requests the driver serves in one pass
+#define MAX_MERGE 16
+// most device operations the driver plans ahead, see serveBatch
+#define MAX_OPS 64
+Operation opList[USLOSS_DISK_UNITS][MAX_OPS];
+char mergeBuffer[USLOSS_DISK_UNITS][MAX_OPS][USLOSS_DISK_SECTOR_SIZE];
+
+// per-unit counters and latency histograms, see P2_DiskStats
+P2_DiskStatistics stats[USLOSS_DISK_UNITS];
+
+// seek counters, see P2_DiskSeekStats
+int seeksIssued[USLOSS_DISK_UNITS];
+int seeksElided[USLOSS_DISK_UNITS];
+int tracksTraveled[USLOSS_DISK_UNITS];
+
+/*
+ * Sector buffer cache shared by all units. Blocks are found through a small hash table
+ * and replaced with the CLOCK algorithm. The driver stores every sector it reads or
+ * writes, so a clean block always matches what is on the disk. In write-back mode
+ * writes only update the cache and mark the blocks dirty; dirty blocks hold the newest
+ * data for their sector, are never evicted and are written out by the driver.
+ */
+#define CACHE_BUCKETS 64
+
+// how the driver transferred a sector it hands to cacheStore
+#define CACHE_READ 0
+#define CACHE_WRITE 1
+#define CACHE_PREFETCH 2
+
+typedef struct cb {
+	int valid, referenced;
+	int prefetched; // read ahead and not yet used
+	int dirty;
+	int version; // bumped by every write-back update, so a flush can tell if it raced one
+	int unit, track, sector;
+	char data[USLOSS_DISK_SECTOR_SIZE];
+	struct cb *hashNext;
+} CacheBlock;
+
+CacheBlock cache[P2_DISK_CACHE_MAX];
+CacheBlock *cacheBuckets[CACHE_BUCKETS];
+int cacheSize = P2_DISK_CACHE_DEFAULT; // blocks in use, set by P2DiskSetCacheSize
+int writeBack = FALSE; // set by P2DiskSetWriteBack
+int stripeSectors = P2_STRIPE_DEFAULT; // set by P2DiskSetStripe
+int mirrorUnits[2] = {0, 1}; // units holding the two copies of the mirror, see P2DiskSetMirror
+int mirrorReads[2]; // reads served by each copy, guarded by that copy's unit mutex
+
+/*
+ * Extent allocator. Each unit's free space is kept in a bitmap at the start of the unit,
+ * behind an AllocHeader, one bit per sector with 1 meaning allocated. The header and
+ * bitmap sectors are allocated themselves. The whole image is kept in memory along with
+ * the number of free sectors on each track, and changed sectors of the image are written
+ * back before P2_DiskAlloc or P2_DiskFree returns. Only the first ALLOC_MAX_SECTORS
+ * sectors of a unit are managed.
+ */
+#define ALLOC_MAGIC 0x50324146
+#define ALLOC_MAX_SECTORS (1024 * USLOSS_DISK_TRACK_SIZE)
+
+typedef struct ah {
+	int magic;
+	int sectors; // sectors the bitmap covers
+	int headerSectors; // sectors the header and bitmap take up
+} AllocHeader;
+
+#define ALLOC_IMAGE_SECTORS \
+	((sizeof(AllocHeader) + ALLOC_MAX_SECTORS / 8 + USLOSS_DISK_SECTOR_SIZE - 1) / USLOSS_DISK_SECTOR_SIZE)
+
+char allocImage[USLOSS_DISK_UNITS][ALLOC_IMAGE_SECTORS * USLOSS_DISK_SECTOR_SIZE];
+int allocLoaded[USLOSS_DISK_UNITS]; // TRUE once the unit's image has been read or formatted
+int trackFree[USLOSS_DISK_UNITS][ALLOC_MAX_SECTORS / USLOSS_DISK_TRACK_SIZE];
+
+// bounce buffers for the partly covered first and last sectors of each process's byte
+// transfers, see P2_DiskPread
+char bounce[P1_MAXPROC][2][USLOSS_DISK_SECTOR_SIZE];
+
+/*
+ * Kernel-side copy and fill. Each running P2_DiskCopy or P2_DiskFill holds one of
+ * COPY_SLOTS pairs of chunk buffers, so one chunk can be read while the previous one is
+ * being written.
+ */
+#define COPY_SLOTS 4
+#define COPY_CHUNK USLOSS_DISK_TRACK_SIZE // sectors per chunk
+char copyBuffers[COPY_SLOTS][2][COPY_CHUNK * USLOSS_DISK_SECTOR_SIZE];
+int copyInUse[COPY_SLOTS];
+char flushBuffer[USLOSS_DISK_UNITS][USLOSS_DISK_SECTOR_SIZE];
+int cacheHand;
+// cache counters, in sectors, see P2_DiskCacheStats
+int cacheHits, cacheMisses, cacheEvictions;
+
+/*
+ * Sequential read-ahead. Each process's reads on each unit form a stream; once a read
+ * starts where the stream's previous one ended the next window of sectors is queued
+ * for prefetching into the cache. The window doubles when a read is served from the
+ * cache and halves when it is not. The driver prefetches only while nothing is pending.
+ */
+typedef struct st {
+	int next; // sector the next sequential read starts on, -1 if none yet
+	int window; // sectors to read ahead, 0 if the stream is not sequential
+} Stream;
+
+Stream streams[P1_MAXPROC][USLOSS_DISK_UNITS];
+// sectors still to prefetch on each unit, from prefetchStart up to prefetchEnd
+int prefetchStart[USLOSS_DISK_UNITS], prefetchEnd[USLOSS_DISK_UNITS];
+char prefetchBuffer[USLOSS_DISK_UNITS][USLOSS_DISK_SECTOR_SIZE];
+// read-ahead counters, in sectors, see P2_DiskPrefetchStats
+int prefetchIssued, prefetchHits, prefetchWasted;
+
+/*
+ * Request trace. When enabled with P2DiskSetTrace every finished read and write is
+ * recorded in a ring of traceSize entries, the oldest overwritten first.
+ */
+P2_DiskTraceEntry trace[P2_DISK_TRACE_MAX];
+int traceSize = 0; // set by P2DiskSetTrace, 0 if tracing is off
+int traceNext, traceCount; // where the next entry goes and how many are in the ring
 
 // semaphores
-int requestFinished[USLOSS_DISK_UNITS][QUEUE_SIZE];
 int requestSent[USLOSS_DISK_UNITS];
 int mutex[USLOSS_DISK_UNITS];
+int cacheMutex;
+int traceMutex; // taken with mutex[unit] held, never the other way around
+int allocMutex[USLOSS_DISK_UNITS];
+int partialMutex[USLOSS_DISK_UNITS]; // serializes read-modify-write of partial sectors
+int copySlots; // free entries in copyBuffers
+int copyMutex;
+int poolSlots[USLOSS_DISK_UNITS]; // free requests in the pool
+int waitSems[P1_MAXPROC]; // V'd whenever one of the process's requests finishes, -1 until needed
+int diskTimeouts[P1_MAXPROC]; // set by P2_DiskSetTimeout, 0 for no limit
+int asyncHeld[P1_MAXPROC][USLOSS_DISK_UNITS]; // uncollected asynchronous requests
+int asyncIncarnation[P1_MAXPROC][USLOSS_DISK_UNITS]; // incarnation asyncHeld counts for
+int asyncTotal[USLOSS_DISK_UNITS]; // asyncHeld summed over all processes
+int incarnations[P1_MAXPROC]; // bumped each time the process using a pid is found gone
+int ownerMutex; // serializes bumping incarnations, no other lock is taken while it is held
 
 // helper functions for semaphores, makes code cleaner
 void P(int sid) {
@@ -42,7 +295,16 @@ void V(int sid) {
 	assert(P1_V(sid) == P1_SUCCESS);
 }
 
+// reads the clock device, in microseconds
+static int clockTime(void) {
+	int now;
+	int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+	assert(rc == USLOSS_DEV_OK);
+	return now;
+}
+
 int numDisks = 0;
+int initialized = FALSE;
 
 /*
  * P2DiskInit
@@ -56,32 +318,100 @@ P2DiskInit(void)
 	int rc;
     // initialize data structures here
 	int i, j, status;
-	USLOSS_DeviceRequest request;
+	USLOSS_DeviceRequest request[USLOSS_DISK_UNITS];
 	char name[10];
+	// ask every unit for its size before waiting for any of them, so the probes overlap
 	for (i = 0; i < USLOSS_DISK_UNITS; i++) {
-		request.opr = USLOSS_DISK_TRACKS;
-		request.reg1 = (void*) &(NUM_TRACKS[i]);
-		rc = USLOSS_DeviceOutput(USLOSS_DISK_DEV, i, &request);		
+		request[i].opr = USLOSS_DISK_TRACKS;
+		request[i].reg1 = (void*) &(NUM_TRACKS[i]);
+		rc = USLOSS_DeviceOutput(USLOSS_DISK_DEV, i, &request[i]);
 		if (rc == USLOSS_DEV_OK) numDisks++;
 		else break;
-
+	}
+	for (i = 0; i < numDisks; i++) {
 		rc = P1_WaitDevice(USLOSS_DISK_DEV, i, &status);
 		assert(rc == P1_SUCCESS);
-
-		queueStarts[i] = 0;
-		queueEnds[i] = 0;
+	}
+	for (i = 0; i < numDisks; i++) {
+		schedulers[i] = &schedulerTable[policies[i]];
+		pending[i] = NULL;
+		freeRequests[i] = NULL;
+		headTrack[i] = -1;
+		requestSeq[i] = 0;
+		fairTurn[i] = 0;
+		for (j = 0; j < P1_MAXPROC; j++) {
+			fairCredit[j][i] = 0;
+		}
+		if (!deadlinesSet[i]) {
+			readDeadline[i] = P2_DEADLINE_READ;
+			writeDeadline[i] = P2_DEADLINE_WRITE;
+		}
+		prefetchStart[i] = prefetchEnd[i] = 0;
+		for (j = 0; j < P1_MAXPROC; j++) {
+			streams[j][i].next = -1;
+			streams[j][i].window = 0;
+		}
+		memset(&stats[i], 0, sizeof(stats[i]));
+		seeksIssued[i] = 0;
+		seeksElided[i] = 0;
+		tracksTraveled[i] = 0;
 		sprintf(name, "%d.", i);
 		rc = P1_SemCreate(name, 0, &(requestSent[i]));
 		assert(rc == P1_SUCCESS);
 		sprintf(name, ".%d", i);
 		rc = P1_SemCreate(name, 1, &(mutex[i]));
 		assert(rc == P1_SUCCESS);
-		for (j = 0; j < QUEUE_SIZE; j++) {
-			sprintf(name, "%d", j);
-			rc = P1_SemCreate(name, 0, &(requestFinished[i][j]));
-			assert(rc == P1_SUCCESS);
+		sprintf(name, "%d,", i);
+		rc = P1_SemCreate(name, POOL_SIZE, &(poolSlots[i]));
+		assert(rc == P1_SUCCESS);
+		sprintf(name, "%d;", i);
+		rc = P1_SemCreate(name, 1, &(allocMutex[i]));
+		assert(rc == P1_SUCCESS);
+		sprintf(name, "%d:", i);
+		rc = P1_SemCreate(name, 1, &(partialMutex[i]));
+		assert(rc == P1_SUCCESS);
+		allocLoaded[i] = FALSE;
+		for (j = 0; j < POOL_SIZE; j++) {
+			requests[i][j].unit = i;
+			requests[i][j].inUse = FALSE;
+			requests[i][j].generation = 0;
+			requests[i][j].next = freeRequests[i];
+			freeRequests[i] = &requests[i][j];
+		}
+	}
+	rc = P1_SemCreate("disk cache", 1, &cacheMutex);
+	assert(rc == P1_SUCCESS);
+	rc = P1_SemCreate("disk owners", 1, &ownerMutex);
+	assert(rc == P1_SUCCESS);
+	memset(cache, 0, sizeof(cache));
+	memset(cacheBuckets, 0, sizeof(cacheBuckets));
+	cacheHand = 0;
+	cacheHits = cacheMisses = cacheEvictions = 0;
+	prefetchIssued = prefetchHits = prefetchWasted = 0;
+	rc = P1_SemCreate("disk copy slots", COPY_SLOTS, &copySlots);
+	assert(rc == P1_SUCCESS);
+	rc = P1_SemCreate("disk copy", 1, &copyMutex);
+	assert(rc == P1_SUCCESS);
+	memset(copyInUse, 0, sizeof(copyInUse));
+	// the trace lock is only needed if there is a trace
+	if (traceSize > 0) {
+		rc = P1_SemCreate("disk trace", 1, &traceMutex);
+		assert(rc == P1_SUCCESS);
+	}
+	traceNext = traceCount = 0;
+	for (i = 0; i < P1_MAXPROC; i++) {
+		waitSems[i] = -1;
+		diskTimeouts[i] = 0;
+		incarnations[i] = 0;
+		for (j = 0; j < USLOSS_DISK_UNITS; j++) {
+			asyncHeld[i][j] = 0;
+			asyncIncarnation[i][j] = 0;
 		}
 	}
+	for (i = 0; i < USLOSS_DISK_UNITS; i++) {
+		asyncTotal[i] = 0;
+	}
+	initialized = TRUE;
 
     // install system call stubs here
 
@@ -91,6 +421,40 @@ P2DiskInit(void)
 	assert(rc == P1_SUCCESS);
 	rc = P2_SetSyscallHandler(SYS_DISKSIZE, DiskSizeStub); //added
     assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKREADASYNC, DiskReadAsyncStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKWRITEASYNC, DiskWriteAsyncStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKWAIT, DiskWaitStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKWAITANY, DiskWaitAnyStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKREADV, DiskReadVStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKWRITEV, DiskWriteVStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKFLUSH, DiskFlushStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKSTATS, DiskStatsStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKSETWEIGHT, DiskSetWeightStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKALLOC, DiskAllocStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKFREE, DiskFreeStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKPREAD, DiskPreadStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKPWRITE, DiskPwriteStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKCOPY, DiskCopyStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKFILL, DiskFillStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKCANCEL, DiskCancelStub);
+	assert(rc == P1_SUCCESS);
+	rc = P2_SetSyscallHandler(SYS_DISKSETTIMEOUT, DiskSetTimeoutStub);
+	assert(rc == P1_SUCCESS);
 
     // fork the disk drivers here
 	int pid;
@@ -106,15 +470,34 @@ int shutdown = FALSE;
 /*
  * P2DiskShutdown
  *
- * Clean up the disk data structures and stop the disk drivers.
+ * Clean up the disk data structures and stop the disk drivers. Dirty sectors are
+ * written to disk first.
  */
 
 void 
 P2DiskShutdown(void) 
 {
 	checkIfIsKernel(); //added
+	int i, j;
+	if (writeBack) {
+		for (i = 0; i < numDisks; i++) {
+			int rc = P2_DiskFlush(i);
+			assert(rc == P1_SUCCESS);
+		}
+	}
+	// nobody will serve what is still queued
+	for (i = 0; i < numDisks; i++) {
+		P(mutex[i]);
+		for (j = 0; j < POOL_SIZE; j++) {
+			Request *request = &requests[i][j];
+			if (request->inUse && !request->done && !request->serving) {
+				dropRequest(i, request, P2_CANCELLED);
+				wakeOwner(request);
+			}
+		}
+		V(mutex[i]);
+	}
 	shutdown = TRUE;
-	int i;
 	for (i = 0; i < numDisks; i++) {
 		V(requestSent[i]);
 	}
@@ -134,27 +517,46 @@ DiskDriver(void *arg)
     	//   wait for next request
 		P(requestSent[driverNum]);
 		if (shutdown) break;	
-		Request request = queue[driverNum][queueStarts[driverNum]];
+		P(mutex[driverNum]);
+		Request *batch[MAX_MERGE];
+		int i, n = 0;
+		dropStale(driverNum);
+		batch[0] = schedulers[driverNum]->pickNext(driverNum);
+		if (batch[0] != NULL) n = batch[0]->segments == NULL ? mergeAdjacent(driverNum, batch) : 1;
+		int dispatched = clockTime();
+		for (i = 0; i < n; i++) {
+			batch[i]->dispatched = dispatched;
+			batch[i]->serving = TRUE;
+		}
+		stats[driverNum].queueDepth -= n;
+		V(mutex[driverNum]);
+		// requests merged into an earlier pass leave their wakeups behind, and
+		// read-ahead gets its own
+		if (n == 0) {
+			prefetch(driverNum);
+			flushDirty(driverNum, TRUE);
+			continue;
+		}
 	 	
-		int currentTrack = request.track;
-		moveTrack(request.track, driverNum);
-		int i, index = request.first;
-		queue[driverNum][queueStarts[driverNum]].succeeded = TRUE;
-		for (i = 0; i < request.sectors; i++) {	
-			if (index == USLOSS_DISK_TRACK_SIZE) {
-				if ((++currentTrack) >= NUM_TRACKS[driverNum]) {
-					queue[driverNum][queueStarts[driverNum]].succeeded = FALSE;	
-					break;
-				}
-				moveTrack(currentTrack, driverNum);
-				index = 0;
-			}
-			completeReadWriteAt(request.type, index, driverNum, request.buffer + i*USLOSS_DISK_SECTOR_SIZE);
-			index++;
+		if (batch[0]->type == DISK_FLUSH) {
+			flushDirty(driverNum, FALSE);
+			batch[0]->succeeded = TRUE;
+		} else if (batch[0]->segments != NULL) {
+			serveVector(driverNum, batch[0]);
+		} else {
+			serveBatch(driverNum, batch, n);
 		}
 		
-		V(requestFinished[driverNum][queueStarts[driverNum]]);
-		queueStarts[driverNum] = (queueStarts[driverNum] + 1) % QUEUE_SIZE;
+		P(mutex[driverNum]);
+		int completed = clockTime();
+		for (i = 0; i < n; i++) {
+			schedulers[driverNum]->complete(driverNum, batch[i]);
+			recordRequest(batch[i], completed);
+		}
+		V(mutex[driverNum]);
+		for (i = 0; i < n; i++) {
+			finishRequest(batch[i]);
+		}
 
     	//   while request isn't complete
     	//          send appropriate operation to disk (USLOSS_DeviceOutput)
@@ -166,34 +568,587 @@ DiskDriver(void *arg)
     return P1_SUCCESS;
 }
 
+// first and one-past-last sector of a request, counted from the start of the unit
+#define REQUEST_START(r) ((r)->track * USLOSS_DISK_TRACK_SIZE + (r)->first)
+#define REQUEST_END(r) (REQUEST_START(r) + (r)->sectors)
+
+// returns TRUE if any sector of a pending request lies in [start,end)
+static int
+overlaps(Request *request, int start, int end)
+{
+	int i;
+	if (request->segments == NULL) {
+		return request->sectors > 0 && REQUEST_START(request) < end && REQUEST_END(request) > start;
+	}
+	for (i = 0; i < request->count; i++) {
+		P2_DiskSegment *segment = &request->segments[i];
+		int first = segment->track * USLOSS_DISK_TRACK_SIZE + segment->first;
+		if (segment->sectors > 0 && first < end && first + segment->sectors > start) return TRUE;
+	}
+	return FALSE;
+}
+
 /*
- * P2_DiskWrite
+ * mergeAdjacent
  *
- * Writes the specified number of sectors from the disk starting at the specified track and sector.
+ * Moves pending requests in the same direction whose sectors touch or overlap the run
+ * starting with batch[0] into the batch, so the driver can serve them in one pass.
+ * Candidates are taken in submission order, and the run stops growing at the first
+ * one that would be served ahead of an earlier pending request in the other direction
+ * sharing a sector with the run, so a read never sees a write submitted after it or
+ * misses one submitted before it. Returns the number of requests in the batch.
+ * mutex[unit] must be held.
  */
-int 
-P2_DiskWrite(int unit, int track, int first, int sectors, void *buffer) 
+static int
+mergeAdjacent(int unit, Request **batch)
 {
-	checkIfIsKernel(); //added
+	int n = 1;
+	int start = REQUEST_START(batch[0]), end = REQUEST_END(batch[0]);
+	if (batch[0]->sectors <= 0) return n;
+	while (n < MAX_MERGE) {
+		// the earliest pending request that touches the run
+		Request *other, *candidate = NULL;
+		for (other = pending[unit]; other != NULL; other = other->next) {
+			if (other->type == batch[0]->type && other->segments == NULL && other->sectors > 0 &&
+				REQUEST_START(other) <= end && REQUEST_END(other) >= start &&
+				(candidate == NULL || other->seq < candidate->seq)) {
+				candidate = other;
+			}
+		}
+		if (candidate == NULL) break;
+		int newStart = REQUEST_START(candidate) < start ? REQUEST_START(candidate) : start;
+		int newEnd = REQUEST_END(candidate) > end ? REQUEST_END(candidate) : end;
+		for (other = pending[unit]; other != NULL; other = other->next) {
+			if (other->type != batch[0]->type && other->seq < candidate->seq &&
+				overlaps(other, newStart, newEnd)) {
+				break;
+			}
+		}
+		if (other != NULL) break;
+		schedulers[unit]->remove(unit, candidate);
+		batch[n++] = candidate;
+		start = newStart;
+		end = newEnd;
+	}
+	return n;
+}
+
+/*
+ * serveBatch
+ *
+ * Transfers every sector covered by a batch of same-direction requests once, in order.
+ * A sector read for several requests is read into mergeBuffer and copied to each of them;
+ * a sector several writes cover is written from the latest one. Requests that run off
+ * the end of the disk fail. The seeks and transfers are planned into opList up to
+ * MAX_OPS at a time and run back to back by runOps; the cache is updated afterwards.
+ * Requests that have been cancelled or run out of time get no more stretches.
+ */
+static void
+serveBatch(int unit, Request **batch, int n)
+{
+	int i, j, ops, sector, start = REQUEST_START(batch[0]), end = REQUEST_END(batch[0]);
+	int type = batch[0]->type, lastTrack = -1;
+	Operation *list = opList[unit];
+	for (i = 0; i < n; i++) {
+		batch[i]->succeeded = TRUE;
+		if (REQUEST_START(batch[i]) < start) start = REQUEST_START(batch[i]);
+		if (REQUEST_END(batch[i]) > end) end = REQUEST_END(batch[i]);
+	}
+	sector = start;
+	while (sector < end) {
+		// requests cancelled or out of time are dropped between stretches; a planned
+		// stretch always runs to the end, so the head is where planSeek left it
+		int now = clockTime(), active = 0;
+		for (i = 0; i < n; i++) {
+			if (!requestStopped(batch[i], now)) active++;
+		}
+		if (active == 0) break;
+		// plan the next stretch of device operations, leaving room for a seek
+		for (ops = 0; sector < end && ops < MAX_OPS - 1; sector++) {
+			int track = sector / USLOSS_DISK_TRACK_SIZE;
+			if (track >= NUM_TRACKS[unit]) {
+				for (i = 0; i < n; i++) {
+					if (REQUEST_END(batch[i]) > sector) batch[i]->succeeded = FALSE;
+				}
+				end = sector;
+				break;
+			}
+			// find the requests covering this sector
+			Request *latest = NULL;
+			int covering = 0;
+			for (i = 0; i < n; i++) {
+				if (REQUEST_START(batch[i]) <= sector && sector < REQUEST_END(batch[i]) &&
+					batch[i]->error == P1_SUCCESS) {
+					batch[i]->started = TRUE;
+					covering++;
+					if (latest == NULL || batch[i]->seq > latest->seq) latest = batch[i];
+				}
+			}
+			if (covering == 0) continue;
+			// the head is only moved, or found already there, once per track
+			if (track != lastTrack && planSeek(track, unit)) {
+				list[ops].opr = USLOSS_DISK_SEEK;
+				list[ops].arg = track;
+				list[ops].data = NULL;
+				ops++;
+			}
+			lastTrack = track;
+			list[ops].opr = type;
+			list[ops].arg = sector % USLOSS_DISK_TRACK_SIZE;
+			list[ops].sector = sector;
+			list[ops].data = latest->buffer + (sector - REQUEST_START(latest)) * USLOSS_DISK_SECTOR_SIZE;
+			if (type == USLOSS_DISK_READ && covering > 1) {
+				// overlapping reads share one transfer, copied out to each below
+				list[ops].data = mergeBuffer[unit][ops];
+			}
+			ops++;
+		}
+		runOps(unit, list, ops);
+		for (j = 0; j < ops; j++) {
+			if (list[j].opr == USLOSS_DISK_SEEK) continue;
+			int track = list[j].sector / USLOSS_DISK_TRACK_SIZE;
+			int index = list[j].sector % USLOSS_DISK_TRACK_SIZE;
+			// a read picks up the newer contents of a dirty block
+			cacheStore(unit, track, index, list[j].data,
+					   type == USLOSS_DISK_READ ? CACHE_READ : CACHE_WRITE);
+			if (list[j].data != mergeBuffer[unit][j]) continue;
+			for (i = 0; i < n; i++) {
+				if (REQUEST_START(batch[i]) <= list[j].sector && list[j].sector < REQUEST_END(batch[i])) {
+					memcpy(batch[i]->buffer + (list[j].sector - REQUEST_START(batch[i])) * USLOSS_DISK_SECTOR_SIZE,
+						   list[j].data, USLOSS_DISK_SECTOR_SIZE);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * runOps
+ *
+ * Sends a planned list of operations to the unit back to back. All the bookkeeping for
+ * the list is done before and after it, so the device is handed its next operation as
+ * soon as the driver wakes from the previous one.
+ */
+static void
+runOps(int unit, Operation *list, int n)
+{
+	int i, rc, status;
+	USLOSS_DeviceRequest request;
+	for (i = 0; i < n; i++) {
+		request.opr = list[i].opr;
+		request.reg1 = (void*) list[i].arg;
+		request.reg2 = list[i].data;
+		rc = USLOSS_DeviceOutput(USLOSS_DISK_DEV, unit, &request);
+		assert(rc == USLOSS_DEV_OK);
+		rc = P1_WaitDevice(USLOSS_DISK_DEV, unit, &status);
+		assert(rc == P1_SUCCESS);
+	}
+}
+
+/*
+ * serveVector
+ *
+ * Serves the valid segments of a vectored request in order of their first sector and
+ * records each segment's status.
+ */
+static void
+serveVector(int unit, Request *request)
+{
+	int order[P2_DISK_MAX_SEGMENTS];
+	int i, j, n = 0;
+	request->succeeded = TRUE;
+	for (i = 0; i < request->count; i++) {
+		if (request->status[i] != P1_SUCCESS) continue;
+		P2_DiskSegment *segment = &request->segments[i];
+		int start = segment->track * USLOSS_DISK_TRACK_SIZE + segment->first;
+		for (j = n; j > 0; j--) {
+			P2_DiskSegment *before = &request->segments[order[j-1]];
+			if (before->track * USLOSS_DISK_TRACK_SIZE + before->first <= start) break;
+			order[j] = order[j-1];
+		}
+		order[j] = i;
+		n++;
+	}
+	for (i = 0; i < n; i++) {
+		P2_DiskSegment *segment = &request->segments[order[i]];
+		if (requestStopped(request, clockTime())) {
+			request->status[order[i]] = request->error;
+			continue;
+		}
+		Request part = *request;
+		Request *batch = &part;
+		part.track = segment->track;
+		part.first = segment->first;
+		part.sectors = segment->sectors;
+		part.buffer = segment->buffer;
+		part.origin = request;
+		serveBatch(unit, &batch, 1);
+		request->started |= part.started;
+		if (part.error != P1_SUCCESS) {
+			request->error = part.error;
+			request->status[order[i]] = part.error;
+		} else if (!part.succeeded) {
+			request->status[order[i]] = P2_INVALID_SECTORS;
+			request->succeeded = FALSE;
+		}
+	}
+}
+
+// returns TRUE if a process has quit or its pid is no longer in use
+static int processGone(int pid) {
+	P1_ProcInfo info;
+	int rc = P1_GetProcInfo(pid, &info);
+	return rc != P1_SUCCESS || info.state == P1_STATE_QUIT || info.state == P1_STATE_FREE;
+}
+
+// returns TRUE if the process that submitted a request has gone. The first time that is
+// noticed the pid's incarnation moves on, so a process that later reuses the pid is not
+// taken for the owner of the requests, counts and wakeups the old one left behind.
+static int ownerGone(Request *request) {
+	int gone;
+	P(ownerMutex);
+	gone = request->incarnation != incarnations[request->owner];
+	if (!gone && processGone(request->owner)) {
+		incarnations[request->owner]++;
+		gone = TRUE;
+	}
+	V(ownerMutex);
+	return gone;
+}
+
+// wakes the owner of a request, unless the process using its pid is a later one
+static void wakeOwner(Request *request) {
+	if (request->incarnation == incarnations[request->owner]) V(waitSems[request->owner]);
+}
+
+// returns TRUE if the driver should stop serving a request because it was cancelled,
+// ran past its timeout or its owner has gone, and records why in its error
+static int requestStopped(Request *request, int now) {
+	if (request->error == P1_SUCCESS) {
+		Request *origin = request->origin != NULL ? request->origin : request;
+		if (origin->cancelled || ownerGone(request)) {
+			request->error = P2_CANCELLED;
+		} else if (request->timeout > 0 && now - request->submitted >= request->timeout) {
+			request->error = P2_TIMED_OUT;
+		}
+	}
+	return request->error != P1_SUCCESS;
+}
+
+// takes a request that is still pending off its unit's queue and finishes it with an
+// error. mutex[unit] must be held; the caller wakes the owner if it should be woken.
+// Every policy keeps pending requests on pending[unit], and going around the policy's
+// remove hook keeps the fair policy from charging for a request that was never served.
+static void dropRequest(int unit, Request *request, int error) {
+	int i;
+	listRemove(unit, request);
+	stats[unit].queueDepth--;
+	request->error = error;
+	request->done = TRUE;
+	// none of a vectored request's valid segments has been served
+	for (i = 0; request->segments != NULL && i < request->count; i++) {
+		if (request->status[i] == P1_SUCCESS) request->status[i] = error;
+	}
+}
+
+/*
+ * dropStale
+ *
+ * Finishes the unit's pending requests that have run past their timeout before the
+ * driver picks its next request, and cancels the outstanding requests of processes that
+ * have gone. Requests of gone processes go straight back to the pool since nobody will
+ * collect them, including finished asynchronous ones. mutex[unit] must be held.
+ */
+static void
+dropStale(int unit)
+{
+	int i, now = clockTime();
+	for (i = 0; i < POOL_SIZE; i++) {
+		Request *request = &requests[unit][i];
+		if (!request->inUse || (request->serving && !request->done)) continue;
+		if (!request->done && requestStopped(request, now)) {
+			dropRequest(unit, request, request->error);
+			wakeOwner(request);
+		}
+		if (request->done && ownerGone(request)) {
+			releaseRequest(unit, request);
+			V(poolSlots[unit]);
+		}
+	}
+}
+
+// checks the arguments common to all read and write requests
+static int checkRequest(int unit, int track, int first, void *buffer) {
 	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
 	if (track < 0 || track >= NUM_TRACKS[unit]) return P2_INVALID_TRACK;
 	if (first < 0 || first >= USLOSS_DISK_TRACK_SIZE) return P2_INVALID_FIRST;
 	if (buffer == NULL) return P2_NULL_ADDRESS;
-	
-    // give request to the proper device driver
+	return P1_SUCCESS;
+}
+
+// returns the calling process's wait semaphore, creating it on first use
+static int waitSem(int pid) {
+	assert(pid >= 0 && pid < P1_MAXPROC);
+	if (waitSems[pid] == -1) {
+		char name[P1_MAXNAME+1];
+		snprintf(name, sizeof(name), "disk wait %d", pid);
+		int rc = P1_SemCreate(name, 0, &waitSems[pid]);
+		assert(rc == P1_SUCCESS);
+	}
+	return waitSems[pid];
+}
+
+// returns a request to the pool, mutex[unit] must be held
+static void releaseRequest(int unit, Request *request) {
+	if (request->async) {
+		// a later process on the pid starts its own count
+		if (request->incarnation == asyncIncarnation[request->owner][unit]) {
+			asyncHeld[request->owner][unit]--;
+		}
+		asyncTotal[unit]--;
+	}
+	request->inUse = FALSE;
+	request->next = freeRequests[unit];
+	freeRequests[unit] = request;
+}
+
+// marks a request done and wakes its owner
+static void finishRequest(Request *request) {
+	P(mutex[request->unit]);
+	request->done = TRUE;
+	V(mutex[request->unit]);
+	wakeOwner(request);
+}
+
+// takes a request out of the pool, blocking while it is empty, and fills it in. Must be
+// called without mutex[unit] held; returns with it held.
+static Request *allocRequest(int type, int unit, int track, int first, int sectors, void *buffer) {
+	int owner = P1_GetPid();
+	waitSem(owner);
+	P(poolSlots[unit]);
 	P(mutex[unit]);
-	int requestIndex = queueEnds[unit];
-	queue[unit][requestIndex].type = USLOSS_DISK_WRITE;
-	queue[unit][requestIndex].track = track;
-	queue[unit][requestIndex].first = first;
-	queue[unit][requestIndex].sectors = sectors;
-	queue[unit][requestIndex].buffer = buffer;
-	queueEnds[unit] = (queueEnds[unit] + 1) % QUEUE_SIZE;
+	Request *request = freeRequests[unit];
+	assert(request != NULL);
+	freeRequests[unit] = request->next;
+	request->type = type;
+	request->track = track;
+	request->first = first;
+	request->sectors = sectors;
+	request->buffer = buffer;
+	request->segments = NULL;
+	request->inUse = TRUE;
+	request->done = FALSE;
+	request->owner = owner;
+	request->incarnation = incarnations[owner];
+	request->generation = (request->generation + 1) % MAX_GENERATION;
+	request->seq = requestSeq[unit]++;
+	request->submitted = clockTime();
+	request->timeout = diskTimeouts[owner];
+	request->serving = FALSE;
+	request->started = FALSE;
+	request->cancelled = FALSE;
+	request->async = FALSE;
+	request->error = P1_SUCCESS;
+	request->origin = NULL;
+	return request;
+}
+
+// hands a request to the unit's scheduler, mutex[unit] must be held
+static void queueRequest(Request *request) {
+	P2_DiskStatistics *unitStats = &stats[request->unit];
+	schedulers[request->unit]->enqueue(request->unit, request);
+	if (++unitStats->queueDepth > unitStats->maxQueueDepth) {
+		unitStats->maxQueueDepth = unitStats->queueDepth;
+	}
+}
+
+// returns the histogram bucket for a time in microseconds
+static int histogramBucket(int us) {
+	int bucket = 0;
+	while (us > 1 && bucket < P2_DISK_HIST_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+// adds an entry to the trace ring, each segment of a vectored request gets its own
+static void traceRecord(Request *request, int track, int first, int sectors, int completed) {
+	P(traceMutex);
+	P2_DiskTraceEntry *entry = &trace[traceNext];
+	entry->time = request->submitted;
+	entry->pid = request->owner;
+	entry->unit = request->unit;
+	entry->type = request->type;
+	entry->track = track;
+	entry->first = first;
+	entry->sectors = sectors;
+	entry->latency = completed - request->submitted;
+	traceNext = (traceNext + 1) % traceSize;
+	if (traceCount < traceSize) traceCount++;
+	V(traceMutex);
+}
+
+// adds a finished request to its unit's counters and histograms, mutex[unit] must be held
+static void recordRequest(Request *request, int completed) {
+	P2_DiskStatistics *unitStats = &stats[request->unit];
+	int i, sectors = request->sectors;
+	if (request->type == DISK_FLUSH) {
+		unitStats->flushes++;
+	} else {
+		if (request->segments != NULL) {
+			for (i = 0, sectors = 0; i < request->count; i++) {
+				if (request->status[i] == P1_SUCCESS) sectors += request->segments[i].sectors;
+			}
+		}
+		if (request->type == USLOSS_DISK_READ) {
+			unitStats->reads++;
+			unitStats->sectorsRead += sectors;
+		} else {
+			unitStats->writes++;
+			unitStats->sectorsWritten += sectors;
+		}
+	}
+	unitStats->queueWait[histogramBucket(request->dispatched - request->submitted)]++;
+	unitStats->service[histogramBucket(completed - request->dispatched)]++;
+	unitStats->latency[histogramBucket(completed - request->submitted)]++;
+	if (traceSize > 0 && request->type != DISK_FLUSH) {
+		if (request->segments == NULL) {
+			traceRecord(request, request->track, request->first, request->sectors, completed);
+		}
+		for (i = 0; request->segments != NULL && i < request->count; i++) {
+			if (request->status[i] == P1_SUCCESS) {
+				P2_DiskSegment *segment = &request->segments[i];
+				traceRecord(request, segment->track, segment->first, segment->sectors, completed);
+			}
+		}
+	}
+}
+
+/*
+ * submitRequest
+ *
+ * Hands a request to the unit's scheduler and wakes the driver. Reads that the buffer
+ * cache can serve, and writes it can absorb in write-back mode, are completed right away.
+ */
+static Request *
+submitRequest(int type, int unit, int track, int first, int sectors, void *buffer)
+{
+	int hit;
+	if (type == USLOSS_DISK_READ) {
+		hit = cacheRead(unit, track, first, sectors, buffer);
+		readAhead(unit, track * USLOSS_DISK_TRACK_SIZE + first, sectors, hit);
+	} else {
+		hit = writeBack && cacheWrite(unit, track, first, sectors, buffer);
+		// let the driver start writing the dirty sectors back once it is idle
+		if (hit) V(requestSent[unit]);
+	}
+	Request *request = allocRequest(type, unit, track, first, sectors, buffer);
+	if (hit) {
+		request->serving = TRUE;
+		request->dispatched = request->submitted;
+		recordRequest(request, request->submitted);
+	} else {
+		queueRequest(request);
+	}
+	V(mutex[unit]);
+	if (hit) {
+		request->succeeded = TRUE;
+		finishRequest(request);
+	} else {
+		V(requestSent[unit]);
+	}
+	return request;
+}
+
+/*
+ * submitVector
+ *
+ * Hands a vectored request to the unit's scheduler as a single request. The scheduler
+ * sees the lowest track any valid segment starts on.
+ */
+static Request *
+submitVector(int type, int unit, P2_DiskSegment *segments, int count, int *status)
+{
+	int i, track = -1;
+	for (i = 0; i < count; i++) {
+		if (status[i] == P1_SUCCESS && (track == -1 || segments[i].track < track)) {
+			track = segments[i].track;
+		}
+		if (status[i] == P1_SUCCESS && type == USLOSS_DISK_WRITE && writeBack) {
+			cacheOverwrite(unit, segments[i].track, segments[i].first, segments[i].sectors,
+						   segments[i].buffer);
+		}
+	}
+	Request *request = allocRequest(type, unit, track, 0, 0, NULL);
+	request->segments = segments;
+	request->count = count;
+	request->status = status;
+	queueRequest(request);
 	V(mutex[unit]);
 	V(requestSent[unit]);
-	// wait until device driver completes the request
-	P(requestFinished[unit][requestIndex]);
-    return queue[unit][requestIndex].succeeded ? P1_SUCCESS : P2_INVALID_SECTORS;
+	return request;
+}
+
+/*
+ * waitRequest
+ *
+ * Waits until the driver has served a request, releases it and returns its status.
+ */
+static int
+waitRequest(Request *request)
+{
+	int unit = request->unit;
+	P(mutex[unit]);
+	while (!request->done) {
+		V(mutex[unit]);
+		// the semaphore counts every finished request of this process, and any an earlier
+		// process on the pid left behind, so recheck
+		P(waitSems[request->owner]);
+		P(mutex[unit]);
+	}
+	int rc = request->error != P1_SUCCESS ? request->error :
+			 request->succeeded ? P1_SUCCESS : P2_INVALID_SECTORS;
+	releaseRequest(unit, request);
+	V(mutex[unit]);
+	V(poolSlots[unit]);
+	return rc;
+}
+
+// handles encode the request's slot and generation so stale handles are rejected
+static int requestToHandle(Request *request) {
+	int slot = request->unit * POOL_SIZE + (request - requests[request->unit]);
+	return request->generation * USLOSS_DISK_UNITS * POOL_SIZE + slot;
+}
+
+// returns the in-use request a handle of the calling process refers to, or NULL
+static Request *handleToRequest(int handle) {
+	if (handle < 0) return NULL;
+	int slot = handle % (USLOSS_DISK_UNITS * POOL_SIZE);
+	int unit = slot / POOL_SIZE;
+	if (unit >= numDisks) return NULL;
+	Request *request = &requests[unit][slot % POOL_SIZE];
+	if (!request->inUse || request->generation != handle / (USLOSS_DISK_UNITS * POOL_SIZE) ||
+		request->owner != P1_GetPid() || request->incarnation != incarnations[request->owner]) {
+		return NULL;
+	}
+	return request;
+}
+
+/*
+ * P2_DiskWrite
+ *
+ * Writes the specified number of sectors from the disk starting at the specified track and sector.
+ */
+int 
+P2_DiskWrite(int unit, int track, int first, int sectors, void *buffer) 
+{
+	checkIfIsKernel(); //added
+	int rc = checkRequest(unit, track, first, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	
+    // give request to the proper device driver
+	return waitRequest(submitRequest(USLOSS_DISK_WRITE, unit, track, first, sectors, buffer));
 }
 
 /*
@@ -226,50 +1181,1675 @@ int
 P2_DiskRead(int unit, int track, int first, int sectors, void *buffer) 
 {
 	checkIfIsKernel(); //added
-	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
-	if (track < 0 || track >= NUM_TRACKS[unit]) return P2_INVALID_TRACK;
-	if (first < 0 || first >= USLOSS_DISK_TRACK_SIZE) return P2_INVALID_FIRST;
+	int rc = checkRequest(unit, track, first, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	
+    // give request to the proper device driver
+	return waitRequest(submitRequest(USLOSS_DISK_READ, unit, track, first, sectors, buffer));
+}
+
+/*
+ * DiskReadStub
+ *
+ * Stub for the Sys_DiskRead system call.
+ */
+static void 
+DiskReadStub(USLOSS_Sysargs *sysargs) 
+{
+	checkIfIsKernel(); //added
+	void *buffer = sysargs->arg1;
+	int sectors = (int) sysargs->arg2;
+	int track = (int) sysargs->arg3;
+	int first = (int) sysargs->arg4;
+	int unit = (int) sysargs->arg5;
+	
+    // call P2_DiskRead
+    // put result in sysargs
+	sysargs->arg4 = (void*) P2_DiskRead(unit, track, first, sectors, buffer);
+}
+
+/*
+ * P2DiskSetScheduler
+ *
+ * Selects the scheduling policy for a unit. Must be called before P2DiskInit; units
+ * that are never configured use P2_DISK_FIFO.
+ */
+int
+P2DiskSetScheduler(int unit, int policy)
+{
+	checkIfIsKernel();
+	if (unit < 0 || unit >= USLOSS_DISK_UNITS) return P1_INVALID_UNIT;
+	if (policy < 0 || policy >= NUM_POLICIES) return P2_INVALID_POLICY;
+	if (initialized) return P1_INVALID_STATE;
+	policies[unit] = policy;
+	return P1_SUCCESS;
+}
+
+// FIFO: serve requests in the order they arrived
+static void fifoEnqueue(int unit, Request *request) {
+	Request **tail = &pending[unit];
+	while (*tail != NULL) tail = &(*tail)->next;
+	request->next = NULL;
+	*tail = request;
+}
+
+// FIFO and C-LOOK both keep only the pending list
+static void listRemove(int unit, Request *request) {
+	Request **prev = &pending[unit];
+	while (*prev != request) prev = &(*prev)->next;
+	*prev = request->next;
+}
+
+// returns TRUE if a request is a flush and a write submitted before it is still pending.
+// A flush is a barrier for the writes before it, so it waits for them whatever the policy.
+static int flushHeld(int unit, Request *request) {
+	Request *other;
+	if (request->type != DISK_FLUSH) return FALSE;
+	for (other = pending[unit]; other != NULL; other = other->next) {
+		if (other->type == USLOSS_DISK_WRITE && other->seq < request->seq) return TRUE;
+	}
+	return FALSE;
+}
+
+static Request *fifoPickNext(int unit) {
+	Request **prev = &pending[unit];
+	while (*prev != NULL && flushHeld(unit, *prev)) prev = &(*prev)->next;
+	Request *request = *prev;
+	if (request != NULL) *prev = request->next;
+	return request;
+}
+
+// C-LOOK: keep the pending list sorted by track and sweep the head toward higher
+// tracks, jumping back to the lowest pending track once nothing lies ahead of it
+static void clookEnqueue(int unit, Request *request) {
+	Request **prev = &pending[unit];
+	while (*prev != NULL && (*prev)->track <= request->track) prev = &(*prev)->next;
+	request->next = *prev;
+	*prev = request;
+}
+
+static Request *clookPickNext(int unit) {
+	Request **prev = &pending[unit];
+	while (*prev != NULL && ((*prev)->track < headTrack[unit] || flushHeld(unit, *prev))) {
+		prev = &(*prev)->next;
+	}
+	if (*prev == NULL) {
+		prev = &pending[unit];
+		while (*prev != NULL && flushHeld(unit, *prev)) prev = &(*prev)->next;
+	}
+	Request *request = *prev;
+	if (request != NULL) *prev = request->next;
+	return request;
+}
+
+// Deadline: C-LOOK, except that once the oldest pending request has waited past its
+// deadline it is served next, wherever it lies. Reads get the shorter deadline since
+// their submitters are blocked waiting for the data.
+static void deadlineEnqueue(int unit, Request *request) {
+	int wait = request->type == USLOSS_DISK_READ ? readDeadline[unit] : writeDeadline[unit];
+	request->deadline = request->submitted + wait;
+	clookEnqueue(unit, request);
+}
+
+static Request *deadlinePickNext(int unit) {
+	Request **prev, **expired = NULL;
+	for (prev = &pending[unit]; *prev != NULL; prev = &(*prev)->next) {
+		if (flushHeld(unit, *prev)) continue;
+		if (expired == NULL || (*prev)->deadline < (*expired)->deadline) expired = prev;
+	}
+	if (expired == NULL || (*expired)->deadline > clockTime()) return clookPickNext(unit);
+	Request *request = *expired;
+	*expired = request->next;
+	if (request->type == USLOSS_DISK_READ) {
+		stats[unit].expiredReads++;
+	} else {
+		stats[unit].expiredWrites++;
+	}
+	return request;
+}
+
+// Fair share: the pending list stays in arrival order, and each process's requests on
+// it form its sub-queue. The driver takes turns among the processes with requests
+// pending (deficit round robin): on its turn a process is credited P2_DISK_QUANTUM
+// sectors times its weight and has its oldest requests served while the credit lasts,
+// so a process streaming large requests cannot crowd out the others.
+
+// returns the number of sectors a request transfers, what the fair policy charges for it
+static int requestCost(Request *request) {
+	int i, sectors = request->sectors;
+	if (request->segments != NULL) {
+		for (i = 0, sectors = 0; i < request->count; i++) sectors += request->segments[i].sectors;
+	}
+	return sectors > 0 ? sectors : 1;
+}
+
+// returns a process's weight
+static int diskWeight(int pid) {
+	return diskWeights[pid] > 0 ? diskWeights[pid] : P2_DISK_WEIGHT_DEFAULT;
+}
+
+static Request *fairPickNext(int unit) {
+	if (pending[unit] == NULL) return NULL;
+	for (;;) {
+		int pid = fairTurn[unit];
+		Request **prev = &pending[unit];
+		while (*prev != NULL && ((*prev)->owner != pid || flushHeld(unit, *prev))) {
+			prev = &(*prev)->next;
+		}
+		if (*prev == NULL) {
+			// idle processes do not save up credit
+			fairCredit[pid][unit] = 0;
+		} else if (fairCredit[pid][unit] >= requestCost(*prev)) {
+			Request *request = *prev;
+			*prev = request->next;
+			fairCredit[pid][unit] -= requestCost(request);
+			return request;
+		}
+		pid = fairTurn[unit] = (pid + 1) % P1_MAXPROC;
+		fairCredit[pid][unit] += P2_DISK_QUANTUM * diskWeight(pid);
+	}
+}
+
+// requests merged into another process's transfer are charged to their own process
+static void fairRemove(int unit, Request *request) {
+	listRemove(unit, request);
+	fairCredit[request->owner][unit] -= requestCost(request);
+}
+
+// a request that was stopped before any of it was transferred is not charged
+static void fairComplete(int unit, Request *request) {
+	if (request->error != P1_SUCCESS && !request->started) {
+		fairCredit[request->owner][unit] += requestCost(request);
+	}
+}
+
+static void noComplete(int unit, Request *request) {
+}
+
+/*
+ * P2_DiskSetWeight
+ *
+ * Sets a process's share of the disk bandwidth under the fair policy, between 1 and
+ * P2_DISK_MAX_WEIGHT. A process with weight 2 gets twice the sectors per turn of one
+ * with weight 1. The weight stays with the pid until it is set again.
+ */
+int
+P2_DiskSetWeight(int pid, int weight)
+{
+	checkIfIsKernel();
+	if (pid < 0 || pid >= P1_MAXPROC) return P1_INVALID_PID;
+	if (weight < 1 || weight > P2_DISK_MAX_WEIGHT) return P2_INVALID_WEIGHT;
+	diskWeights[pid] = weight;
+	return P1_SUCCESS;
+}
+
+// stub for P2_DiskSetWeight
+static void
+DiskSetWeightStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskSetWeight((int) sysargs->arg1, (int) sysargs->arg2);
+}
+
+/*
+ * P2DiskSetDeadlines
+ *
+ * Sets how long, in microseconds, the deadline policy lets reads and writes on a unit
+ * wait before serving them out of track order. Must be called before P2DiskInit; the
+ * defaults are P2_DEADLINE_READ and P2_DEADLINE_WRITE.
+ */
+int
+P2DiskSetDeadlines(int unit, int readUs, int writeUs)
+{
+	checkIfIsKernel();
+	if (unit < 0 || unit >= USLOSS_DISK_UNITS) return P1_INVALID_UNIT;
+	if (readUs < 0 || writeUs < 0) return P2_INVALID_POLICY;
+	if (initialized) return P1_INVALID_STATE;
+	readDeadline[unit] = readUs;
+	writeDeadline[unit] = writeUs;
+	deadlinesSet[unit] = TRUE;
+	return P1_SUCCESS;
+}
+
+/*
+ * P2DiskSetCacheSize
+ *
+ * Sets how many sector blocks the buffer cache may use, between 0 (cache disabled) and
+ * P2_DISK_CACHE_MAX. Must be called before P2DiskInit.
+ */
+int
+P2DiskSetCacheSize(int blocks)
+{
+	checkIfIsKernel();
+	if (blocks < 0 || blocks > P2_DISK_CACHE_MAX) return P2_INVALID_SECTORS;
+	if (initialized) return P1_INVALID_STATE;
+	cacheSize = blocks;
+	return P1_SUCCESS;
+}
+
+// returns the cached block for a sector or NULL, cacheMutex must be held
+static CacheBlock *cacheLookup(int unit, int track, int sector) {
+	CacheBlock *block = cacheBuckets[(unit + track * USLOSS_DISK_TRACK_SIZE + sector) % CACHE_BUCKETS];
+	while (block != NULL && !(block->unit == unit && block->track == track && block->sector == sector)) {
+		block = block->hashNext;
+	}
+	return block;
+}
+
+// picks a clean block to reuse with the CLOCK algorithm and unhashes it, or returns NULL
+// if every block is dirty. cacheMutex must be held
+static CacheBlock *cacheVictim(void) {
+	CacheBlock *block = NULL;
+	int i;
+	// two sweeps clear every reference bit, so a clean block is found if there is one
+	for (i = 0; i < 2 * cacheSize; i++) {
+		block = &cache[cacheHand];
+		cacheHand = (cacheHand + 1) % cacheSize;
+		if (!block->valid) return block;
+		if (block->dirty) continue;
+		if (!block->referenced) {
+			CacheBlock **prev = &cacheBuckets[(block->unit + block->track * USLOSS_DISK_TRACK_SIZE + block->sector) % CACHE_BUCKETS];
+			while (*prev != block) prev = &(*prev)->hashNext;
+			*prev = block->hashNext;
+			block->valid = FALSE;
+			cacheEvictions++;
+			if (block->prefetched) prefetchWasted++;
+			return block;
+		}
+		block->referenced = FALSE;
+	}
+	return NULL;
+}
+
+// claims a block for a sector that is not cached, or returns NULL. cacheMutex must be held
+static CacheBlock *cacheInsert(int unit, int track, int sector) {
+	CacheBlock *block = cacheVictim();
+	if (block == NULL) return NULL;
+	block->valid = TRUE;
+	block->dirty = FALSE;
+	block->prefetched = FALSE;
+	block->unit = unit;
+	block->track = track;
+	block->sector = sector;
+	CacheBlock **bucket = &cacheBuckets[(unit + track * USLOSS_DISK_TRACK_SIZE + sector) % CACHE_BUCKETS];
+	block->hashNext = *bucket;
+	*bucket = block;
+	return block;
+}
+
+/*
+ * cacheStore
+ *
+ * Records a sector the driver just transferred. how is CACHE_READ, CACHE_WRITE or
+ * CACHE_PREFETCH. A dirty block is newer than the disk, so it is never replaced and a
+ * read gets its contents copied into data instead. Read-ahead only fills sectors that
+ * are not cached at all.
+ */
+static void
+cacheStore(int unit, int track, int sector, void *data, int how)
+{
+	if (cacheSize == 0) return;
+	P(cacheMutex);
+	CacheBlock *block = cacheLookup(unit, track, sector);
+	if (block != NULL && block->dirty) {
+		if (how == CACHE_READ) memcpy(data, block->data, USLOSS_DISK_SECTOR_SIZE);
+	} else if (block == NULL || how != CACHE_PREFETCH) {
+		if (block == NULL) {
+			block = cacheInsert(unit, track, sector);
+		} else if (block->prefetched) {
+			// transferred again before anyone read it from the cache
+			prefetchWasted++;
+		}
+		if (block != NULL) {
+			block->referenced = how != CACHE_PREFETCH;
+			block->prefetched = how == CACHE_PREFETCH;
+			memcpy(block->data, data, USLOSS_DISK_SECTOR_SIZE);
+		}
+	}
+	V(cacheMutex);
+}
+
+/*
+ * cacheWrite
+ *
+ * Write-back path: copies the sectors into the cache and marks them dirty. Returns TRUE if
+ * every sector was cached; otherwise the caller must also send the write to the driver.
+ * Blocks that were already cached are updated either way, so the cache never holds older
+ * data than the disk will.
+ */
+static int
+cacheWrite(int unit, int track, int first, int sectors, void *buffer)
+{
+	int i, absorbed = TRUE;
+	if (cacheSize == 0) return FALSE;
+	if (track * USLOSS_DISK_TRACK_SIZE + first + sectors > NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE) {
+		// let the driver report the overrun
+		absorbed = FALSE;
+	}
+	P(cacheMutex);
+	for (i = 0; i < sectors; i++) {
+		int t = track + (first + i) / USLOSS_DISK_TRACK_SIZE;
+		int sector = (first + i) % USLOSS_DISK_TRACK_SIZE;
+		if (t >= NUM_TRACKS[unit]) break;
+		CacheBlock *block = cacheLookup(unit, t, sector);
+		if (block == NULL && absorbed) block = cacheInsert(unit, t, sector);
+		if (block == NULL) {
+			absorbed = FALSE;
+			continue;
+		}
+		if (block->prefetched) prefetchWasted++;
+		block->prefetched = FALSE;
+		block->referenced = TRUE;
+		block->dirty = TRUE;
+		block->version++;
+		memcpy(block->data, buffer + i*USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_SECTOR_SIZE);
+	}
+	V(cacheMutex);
+	return absorbed;
+}
+
+/*
+ * cacheOverwrite
+ *
+ * Puts the data of a write that goes to the driver without passing through cacheWrite
+ * into the dirty blocks it covers. The driver never overwrites a dirty block, so they
+ * would otherwise keep serving, and later flush, the older data. The blocks stay dirty:
+ * the write may reach the disk after a newer write-back update of the same sector, and
+ * a flush then puts the newest data back. Bumping the version keeps a flush already
+ * writing the old data from marking them clean.
+ */
+static void
+cacheOverwrite(int unit, int track, int first, int sectors, void *buffer)
+{
+	int i;
+	if (cacheSize == 0) return;
+	P(cacheMutex);
+	for (i = 0; i < sectors; i++) {
+		int t = track + (first + i) / USLOSS_DISK_TRACK_SIZE;
+		CacheBlock *block = cacheLookup(unit, t, (first + i) % USLOSS_DISK_TRACK_SIZE);
+		if (block == NULL || !block->dirty) continue;
+		block->version++;
+		memcpy(block->data, buffer + i*USLOSS_DISK_SECTOR_SIZE, USLOSS_DISK_SECTOR_SIZE);
+	}
+	V(cacheMutex);
+}
+
+/*
+ * flushDirty
+ *
+ * Writes a unit's dirty blocks to disk in track order. When whenIdle is set the driver
+ * is only using spare time, so it stops as soon as a request is pending.
+ */
+static void
+flushDirty(int unit, int whenIdle)
+{
+	int i, last = -1;
+	if (cacheSize == 0) return;
+	while (1) {
+		if (whenIdle) {
+			P(mutex[unit]);
+			int busy = pending[unit] != NULL;
+			V(mutex[unit]);
+			if (busy) {
+				// come back to the rest once the pending requests have been served
+				V(requestSent[unit]);
+				return;
+			}
+		}
+		// find the next dirty block after the last one written
+		P(cacheMutex);
+		CacheBlock *next = NULL;
+		int nextSector = 0;
+		for (i = 0; i < cacheSize; i++) {
+			CacheBlock *block = &cache[i];
+			int sector = block->track * USLOSS_DISK_TRACK_SIZE + block->sector;
+			if (block->valid && block->dirty && block->unit == unit && sector > last &&
+				(next == NULL || sector < nextSector)) {
+				next = block;
+				nextSector = sector;
+			}
+		}
+		if (next == NULL) {
+			V(cacheMutex);
+			return;
+		}
+		int version = next->version;
+		memcpy(flushBuffer[unit], next->data, USLOSS_DISK_SECTOR_SIZE);
+		V(cacheMutex);
+
+		moveTrack(nextSector / USLOSS_DISK_TRACK_SIZE, unit);
+		completeReadWriteAt(USLOSS_DISK_WRITE, nextSector % USLOSS_DISK_TRACK_SIZE, unit, flushBuffer[unit]);
+		last = nextSector;
+
+		P(cacheMutex);
+		// dirty blocks are never evicted, so next still holds this sector
+		if (next->version == version) next->dirty = FALSE;
+		V(cacheMutex);
+	}
+}
+
+// returns TRUE if a sector is cached
+static int cacheContains(int unit, int track, int sector) {
+	P(cacheMutex);
+	int found = cacheLookup(unit, track, sector) != NULL;
+	V(cacheMutex);
+	return found;
+}
+
+// serves a read from the cache if every sector is cached, returns TRUE if it did
+static int cacheRead(int unit, int track, int first, int sectors, void *buffer) {
+	int i, hit = TRUE;
+	if (cacheSize == 0 || sectors <= 0) return FALSE;
+	P(cacheMutex);
+	for (i = 0; i < sectors && hit; i++) {
+		hit = cacheLookup(unit, track + (first + i) / USLOSS_DISK_TRACK_SIZE,
+						  (first + i) % USLOSS_DISK_TRACK_SIZE) != NULL;
+	}
+	if (hit) {
+		for (i = 0; i < sectors; i++) {
+			CacheBlock *block = cacheLookup(unit, track + (first + i) / USLOSS_DISK_TRACK_SIZE,
+											(first + i) % USLOSS_DISK_TRACK_SIZE);
+			block->referenced = TRUE;
+			if (block->prefetched) {
+				prefetchHits++;
+				block->prefetched = FALSE;
+			}
+			memcpy(buffer + i*USLOSS_DISK_SECTOR_SIZE, block->data, USLOSS_DISK_SECTOR_SIZE);
+		}
+		cacheHits += sectors;
+	} else {
+		cacheMisses += sectors;
+	}
+	V(cacheMutex);
+	return hit;
+}
+
+/*
+ * readAhead
+ *
+ * Updates the calling process's stream on a unit after a read of sectors starting at
+ * sector start, and queues the next window for prefetching if the stream is sequential.
+ */
+static void
+readAhead(int unit, int start, int sectors, int hit)
+{
+	int pid = P1_GetPid();
+	if (cacheSize == 0 || sectors <= 0 || pid < 0 || pid >= P1_MAXPROC) return;
+	Stream *stream = &streams[pid][unit];
+	if (start != stream->next) {
+		stream->window = 0;
+	} else if (stream->window == 0) {
+		stream->window = P2_READAHEAD_MIN;
+	} else if (hit) {
+		stream->window *= 2;
+		if (stream->window > P2_READAHEAD_MAX) stream->window = P2_READAHEAD_MAX;
+	} else {
+		stream->window /= 2;
+		if (stream->window < P2_READAHEAD_MIN) stream->window = P2_READAHEAD_MIN;
+	}
+	stream->next = start + sectors;
+	if (stream->window == 0) return;
+
+	int end = stream->next + stream->window;
+	if (end > NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE) end = NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE;
+	// never read ahead more than half the cache, or the window evicts itself
+	if (end - stream->next > cacheSize / 2) end = stream->next + cacheSize / 2;
+	if (end <= stream->next) return;
+	P(mutex[unit]);
+	if (prefetchStart[unit] < prefetchEnd[unit] && prefetchStart[unit] <= stream->next &&
+		prefetchEnd[unit] >= stream->next) {
+		// extend the window still being prefetched
+		if (end > prefetchEnd[unit]) prefetchEnd[unit] = end;
+	} else {
+		prefetchStart[unit] = stream->next;
+		prefetchEnd[unit] = end;
+	}
+	V(mutex[unit]);
+	V(requestSent[unit]);
+}
+
+/*
+ * prefetch
+ *
+ * Called by the driver when it has nothing pending. Reads the queued read-ahead sectors
+ * that are not already cached, stopping as soon as a request arrives.
+ */
+static void
+prefetch(int unit)
+{
+	while (!shutdown) {
+		P(mutex[unit]);
+		int busy = pending[unit] != NULL;
+		int sector = prefetchStart[unit];
+		int more = sector < prefetchEnd[unit];
+		if (!busy && more) prefetchStart[unit]++;
+		V(mutex[unit]);
+		if (!more) break;
+		if (busy) {
+			// come back to the rest once the pending requests have been served
+			V(requestSent[unit]);
+			break;
+		}
+		int track = sector / USLOSS_DISK_TRACK_SIZE;
+		int index = sector % USLOSS_DISK_TRACK_SIZE;
+		if (cacheContains(unit, track, index)) continue;
+		moveTrack(track, unit);
+		completeReadWriteAt(USLOSS_DISK_READ, index, unit, prefetchBuffer[unit]);
+		cacheStore(unit, track, index, prefetchBuffer[unit], CACHE_PREFETCH);
+		prefetchIssued++;
+	}
+}
+
+/*
+ * P2DiskSetWriteBack
+ *
+ * Turns write-back caching on or off. Must be called before P2DiskInit. With it on, writes
+ * complete once their sectors are in the buffer cache, and the driver writes dirty
+ * sectors out when it is idle or when P2_DiskFlush is called.
+ */
+int
+P2DiskSetWriteBack(int enable)
+{
+	checkIfIsKernel();
+	if (initialized) return P1_INVALID_STATE;
+	writeBack = enable;
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskFlush
+ *
+ * Waits until every sector written to the unit before the call is on the disk. The flush
+ * is not served while writes queued before it are pending, whatever the policy.
+ */
+int
+P2_DiskFlush(int unit)
+{
+	checkIfIsKernel();
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	Request *request = allocRequest(DISK_FLUSH, unit, 0, 0, 0, NULL);
+	queueRequest(request);
+	V(mutex[unit]);
+	V(requestSent[unit]);
+	return waitRequest(request);
+}
+
+// stub for P2_DiskFlush
+static void
+DiskFlushStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskFlush((int) sysargs->arg1);
+}
+
+// returns the read-ahead counters, in sectors: how many were prefetched, how many of
+// those were later read from the cache, and how many were evicted or replaced unused
+int P2_DiskPrefetchStats(int *issued, int *hits, int *wasted) {
+	checkIfIsKernel();
+	if (issued == NULL || hits == NULL || wasted == NULL) return P2_NULL_ADDRESS;
+	*issued = prefetchIssued;
+	*hits = prefetchHits;
+	*wasted = prefetchWasted;
+	return P1_SUCCESS;
+}
+
+// returns the buffer cache counters, all counted in sectors
+int P2_DiskCacheStats(int *hits, int *misses, int *evictions) {
+	checkIfIsKernel();
+	if (hits == NULL || misses == NULL || evictions == NULL) return P2_NULL_ADDRESS;
+	*hits = cacheHits;
+	*misses = cacheMisses;
+	*evictions = cacheEvictions;
+	return P1_SUCCESS;
+}
+
+// submits an asynchronous request for the calling process and returns its handle, or
+// P2_TOO_MANY_REQUESTS if the process already holds P2_DISK_MAX_ASYNC on the unit or
+// all processes together hold P2_DISK_MAX_ASYNC_UNIT
+static int submitAsync(int type, int unit, int track, int first, int sectors, void *buffer,
+					   int *handle) {
+	int pid = P1_GetPid();
+	// the slot is counted before it is taken, so the limits hold while we block for it
+	P(mutex[unit]);
+	if (asyncIncarnation[pid][unit] != incarnations[pid]) {
+		asyncIncarnation[pid][unit] = incarnations[pid];
+		asyncHeld[pid][unit] = 0;
+	}
+	if (asyncHeld[pid][unit] >= P2_DISK_MAX_ASYNC || asyncTotal[unit] >= P2_DISK_MAX_ASYNC_UNIT) {
+		V(mutex[unit]);
+		return P2_TOO_MANY_REQUESTS;
+	}
+	asyncHeld[pid][unit]++;
+	asyncTotal[unit]++;
+	V(mutex[unit]);
+	Request *request = submitRequest(type, unit, track, first, sectors, buffer);
+	P(mutex[unit]);
+	request->async = TRUE;
+	V(mutex[unit]);
+	*handle = requestToHandle(request);
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskReadAsync
+ *
+ * Queues a read and returns a handle for it without waiting for the driver. Returns
+ * P2_TOO_MANY_REQUESTS if the caller already has P2_DISK_MAX_ASYNC uncollected
+ * requests on the unit, or all processes together have P2_DISK_MAX_ASYNC_UNIT.
+ */
+int
+P2_DiskReadAsync(int unit, int track, int first, int sectors, void *buffer, int *handle)
+{
+	checkIfIsKernel();
+	int rc = checkRequest(unit, track, first, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	if (handle == NULL) return P2_NULL_ADDRESS;
+	return submitAsync(USLOSS_DISK_READ, unit, track, first, sectors, buffer, handle);
+}
+
+/*
+ * P2_DiskWriteAsync
+ *
+ * Queues a write and returns a handle for it without waiting for the driver. Fails
+ * like P2_DiskReadAsync when there are too many uncollected requests.
+ */
+int
+P2_DiskWriteAsync(int unit, int track, int first, int sectors, void *buffer, int *handle)
+{
+	checkIfIsKernel();
+	int rc = checkRequest(unit, track, first, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	if (handle == NULL) return P2_NULL_ADDRESS;
+	return submitAsync(USLOSS_DISK_WRITE, unit, track, first, sectors, buffer, handle);
+}
+
+/*
+ * P2_DiskCancel
+ *
+ * Cancels an asynchronous request. A request still waiting for the driver is taken off
+ * the queue; one being served is stopped once the driver has finished the stretch of
+ * operations it already sent to the disk, at most MAX_OPS. Sectors already
+ * transferred stay transferred. The handle must still be collected with P2_DiskWait,
+ * which returns P2_CANCELLED unless the request finished first.
+ */
+int
+P2_DiskCancel(int handle)
+{
+	checkIfIsKernel();
+	Request *request = handleToRequest(handle);
+	if (request == NULL) return P2_INVALID_HANDLE;
+	int unit = request->unit;
+	P(mutex[unit]);
+	if (!request->done) {
+		if (request->serving) {
+			request->cancelled = TRUE;
+		} else {
+			dropRequest(unit, request, P2_CANCELLED);
+			wakeOwner(request);
+		}
+	}
+	V(mutex[unit]);
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskSetTimeout
+ *
+ * Limits how long, in microseconds from submission, each disk request the calling
+ * process makes from now on may take; 0 removes the limit. A request that runs out of
+ * time is dropped if it has not started, or stopped like a cancelled one if it has, and
+ * fails with P2_TIMED_OUT.
+ */
+int
+P2_DiskSetTimeout(int us)
+{
+	checkIfIsKernel();
+	if (us < 0) return P2_INVALID_SECONDS;
+	diskTimeouts[P1_GetPid()] = us;
+	return P1_SUCCESS;
+}
+
+// stub for P2_DiskCancel
+static void
+DiskCancelStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskCancel((int) sysargs->arg1);
+}
+
+// stub for P2_DiskSetTimeout
+static void
+DiskSetTimeoutStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskSetTimeout((int) sysargs->arg1);
+}
+
+/*
+ * P2_DiskWait
+ *
+ * Waits for an asynchronous request to finish and returns its status. The handle is
+ * invalid afterwards.
+ */
+int
+P2_DiskWait(int handle)
+{
+	checkIfIsKernel();
+	Request *request = handleToRequest(handle);
+	if (request == NULL) return P2_INVALID_HANDLE;
+	return waitRequest(request);
+}
+
+/*
+ * P2_DiskWaitAny
+ *
+ * Waits until at least one of the n asynchronous requests has finished and returns the
+ * index of one that has. The request stays valid; collect its status with P2_DiskWait.
+ * All of a process's requests wake the same semaphore, so no per-call setup is needed.
+ */
+int
+P2_DiskWaitAny(int *handles, int n)
+{
+	checkIfIsKernel();
+	int i, found = -1;
+	if (handles == NULL) return P2_NULL_ADDRESS;
+	if (n <= 0) return P2_INVALID_HANDLE;
+	for (i = 0; i < n; i++) {
+		if (handleToRequest(handles[i]) == NULL) return P2_INVALID_HANDLE;
+	}
+	int sem = waitSem(P1_GetPid());
+	while (found == -1) {
+		for (i = 0; i < n && found == -1; i++) {
+			Request *request = handleToRequest(handles[i]);
+			P(mutex[request->unit]);
+			if (request->done) found = i;
+			V(mutex[request->unit]);
+		}
+		// a completion may have V'd the semaphore after we last looked, so recheck after waking
+		if (found == -1) P(sem);
+	}
+	return found;
+}
+
+// stub for P2_DiskReadAsync, returns the handle in arg1
+static void
+DiskReadAsyncStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	int handle = -1;
+	int rc = P2_DiskReadAsync((int) sysargs->arg5, (int) sysargs->arg3, (int) sysargs->arg4,
+							  (int) sysargs->arg2, sysargs->arg1, &handle);
+	sysargs->arg1 = (void*) handle;
+	sysargs->arg4 = (void*) rc;
+}
+
+// stub for P2_DiskWriteAsync, returns the handle in arg1
+static void
+DiskWriteAsyncStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	int handle = -1;
+	int rc = P2_DiskWriteAsync((int) sysargs->arg5, (int) sysargs->arg3, (int) sysargs->arg4,
+							   (int) sysargs->arg2, sysargs->arg1, &handle);
+	sysargs->arg1 = (void*) handle;
+	sysargs->arg4 = (void*) rc;
+}
+
+// stub for P2_DiskWait
+static void
+DiskWaitStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskWait((int) sysargs->arg1);
+}
+
+// stub for P2_DiskWaitAny, returns the index in arg1
+static void
+DiskWaitAnyStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	int rc = P2_DiskWaitAny((int *) sysargs->arg1, (int) sysargs->arg2);
+	if (rc >= 0) {
+		sysargs->arg1 = (void*) rc;
+		rc = P1_SUCCESS;
+	}
+	sysargs->arg4 = (void*) rc;
+}
+
+// checks every segment of a vectored request, serves the valid ones and returns P1_SUCCESS
+// or the first error in status
+static int doVector(int type, int unit, P2_DiskSegment *segments, int count, int *status) {
+	int i, rc = P1_SUCCESS;
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	if (segments == NULL || status == NULL) return P2_NULL_ADDRESS;
+	if (count <= 0 || count > P2_DISK_MAX_SEGMENTS) return P2_INVALID_SECTORS;
+	int valid = 0;
+	for (i = 0; i < count; i++) {
+		status[i] = checkRequest(unit, segments[i].track, segments[i].first, segments[i].buffer);
+		if (status[i] == P1_SUCCESS) valid++;
+	}
+	int waited = P1_SUCCESS;
+	if (valid > 0) waited = waitRequest(submitVector(type, unit, segments, count, status));
+	for (i = 0; i < count && rc == P1_SUCCESS; i++) {
+		rc = status[i];
+	}
+	return rc != P1_SUCCESS ? rc : waited;
+}
+
+/*
+ * P2_DiskReadV
+ *
+ * Reads a list of segments as one request, in track order. status[i] receives the result
+ * for segments[i]; the return value is P1_SUCCESS or the first failing status.
+ */
+int
+P2_DiskReadV(int unit, P2_DiskSegment *segments, int count, int *status)
+{
+	checkIfIsKernel();
+	return doVector(USLOSS_DISK_READ, unit, segments, count, status);
+}
+
+/*
+ * P2_DiskWriteV
+ *
+ * Writes a list of segments as one request, in track order. status[i] receives the result
+ * for segments[i]; the return value is P1_SUCCESS or the first failing status.
+ */
+int
+P2_DiskWriteV(int unit, P2_DiskSegment *segments, int count, int *status)
+{
+	checkIfIsKernel();
+	return doVector(USLOSS_DISK_WRITE, unit, segments, count, status);
+}
+
+// stub for P2_DiskReadV
+static void
+DiskReadVStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskReadV((int) sysargs->arg5, sysargs->arg1, (int) sysargs->arg2,
+										 sysargs->arg3);
+}
+
+// stub for P2_DiskWriteV
+static void
+DiskWriteVStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskWriteV((int) sysargs->arg5, sysargs->arg1, (int) sysargs->arg2,
+										  sysargs->arg3);
+}
+
+/*
+ * Striped virtual disk (RAID-0). The logical sectors are dealt out to the units
+ * stripeSectors at a time: logical stripe s lives on unit s % numDisks, starting at
+ * sector (s / numDisks) * stripeSectors of that unit. Every unit contributes as many
+ * whole stripes as the smallest unit holds.
+ */
+
+/*
+ * P2DiskSetStripe
+ *
+ * Sets the stripe size of the striped virtual disk, in sectors. Must be called before
+ * P2DiskInit.
+ */
+int
+P2DiskSetStripe(int sectors)
+{
+	checkIfIsKernel();
+	if (sectors <= 0) return P2_INVALID_SECTORS;
+	if (initialized) return P1_INVALID_STATE;
+	stripeSectors = sectors;
+	return P1_SUCCESS;
+}
+
+// returns the number of logical sectors on the striped virtual disk
+static int stripeCapacity(void) {
+	int unit, tracks = -1;
+	for (unit = 0; unit < numDisks; unit++) {
+		if (tracks == -1 || NUM_TRACKS[unit] < tracks) tracks = NUM_TRACKS[unit];
+	}
+	if (tracks <= 0) return 0;
+	return (tracks * USLOSS_DISK_TRACK_SIZE / stripeSectors) * stripeSectors * numDisks;
+}
+
+/*
+ * stripeTransfer
+ *
+ * Splits a logical transfer into one vectored request per unit, runs them on all the
+ * units' drivers at once and waits for all of them. Transfers that need more segments
+ * than a vectored request holds are done in several rounds.
+ */
+static int
+stripeTransfer(int type, int sector, int sectors, void *buffer)
+{
+	P2_DiskSegment segments[USLOSS_DISK_UNITS][P2_DISK_MAX_SEGMENTS];
+	int status[USLOSS_DISK_UNITS][P2_DISK_MAX_SEGMENTS];
+	int counts[USLOSS_DISK_UNITS];
+	Request *parts[USLOSS_DISK_UNITS];
+	int unit, i, done = 0, rc = P1_SUCCESS;
+
+	while (done < sectors && rc == P1_SUCCESS) {
+		memset(counts, 0, sizeof(counts));
+		while (done < sectors) {
+			int logical = sector + done;
+			int stripe = logical / stripeSectors;
+			int offset = logical % stripeSectors;
+			unit = stripe % numDisks;
+			if (counts[unit] == P2_DISK_MAX_SEGMENTS) break;
+			int n = stripeSectors - offset;
+			if (n > sectors - done) n = sectors - done;
+			int unitSector = (stripe / numDisks) * stripeSectors + offset;
+			P2_DiskSegment *segment = &segments[unit][counts[unit]];
+			segment->track = unitSector / USLOSS_DISK_TRACK_SIZE;
+			segment->first = unitSector % USLOSS_DISK_TRACK_SIZE;
+			segment->sectors = n;
+			segment->buffer = buffer + done * USLOSS_DISK_SECTOR_SIZE;
+			status[unit][counts[unit]++] = P1_SUCCESS;
+			done += n;
+		}
+		for (unit = 0; unit < numDisks; unit++) {
+			if (counts[unit] > 0) {
+				parts[unit] = submitVector(type, unit, segments[unit], counts[unit], status[unit]);
+			}
+		}
+		for (unit = 0; unit < numDisks; unit++) {
+			if (counts[unit] == 0) continue;
+			int waited = waitRequest(parts[unit]);
+			for (i = 0; i < counts[unit]; i++) {
+				if (rc == P1_SUCCESS) rc = status[unit][i];
+			}
+			if (rc == P1_SUCCESS) rc = waited;
+		}
+	}
+	return rc;
+}
+
+// checks the arguments of a striped transfer
+static int checkStripe(int sector, int sectors, void *buffer) {
+	if (numDisks == 0) return P1_INVALID_UNIT;
+	if (sector < 0 || sector >= stripeCapacity()) return P2_INVALID_FIRST;
+	if (sectors < 0 || sector + sectors > stripeCapacity()) return P2_INVALID_SECTORS;
 	if (buffer == NULL) return P2_NULL_ADDRESS;
-	
-    // give request to the proper device driver
-	P(mutex[unit]);
-	int requestIndex = queueEnds[unit];
-	queue[unit][requestIndex].type = USLOSS_DISK_READ;
-	queue[unit][requestIndex].track = track;
-	queue[unit][requestIndex].first = first;
-	queue[unit][requestIndex].sectors = sectors;
-	queue[unit][requestIndex].buffer = buffer;
-	queueEnds[unit] = (queueEnds[unit] + 1) % QUEUE_SIZE;
-	V(mutex[unit]);
-	V(requestSent[unit]);
-	// wait until device driver completes the request
-	P(requestFinished[unit][requestIndex]);
-    return queue[unit][requestIndex].succeeded ? P1_SUCCESS : P2_INVALID_SECTORS;
+	return P1_SUCCESS;
 }
 
 /*
- * DiskReadStub
+ * P2_StripeRead
  *
- * Stub for the Sys_DiskRead system call.
+ * Reads sectors from the striped virtual disk, starting at a logical sector.
  */
-static void 
-DiskReadStub(USLOSS_Sysargs *sysargs) 
+int
+P2_StripeRead(int sector, int sectors, void *buffer)
 {
-	checkIfIsKernel(); //added
-	void *buffer = sysargs->arg1;
-	int sectors = (int) sysargs->arg2;
-	int track = (int) sysargs->arg3;
-	int first = (int) sysargs->arg4;
-	int unit = (int) sysargs->arg5;
-	
-    // call P2_DiskRead
-    // put result in sysargs
-	sysargs->arg4 = (void*) P2_DiskRead(unit, track, first, sectors, buffer);
+	checkIfIsKernel();
+	int rc = checkStripe(sector, sectors, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	return stripeTransfer(USLOSS_DISK_READ, sector, sectors, buffer);
+}
+
+/*
+ * P2_StripeWrite
+ *
+ * Writes sectors to the striped virtual disk, starting at a logical sector.
+ */
+int
+P2_StripeWrite(int sector, int sectors, void *buffer)
+{
+	checkIfIsKernel();
+	int rc = checkStripe(sector, sectors, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	return stripeTransfer(USLOSS_DISK_WRITE, sector, sectors, buffer);
+}
+
+// returns the size of the striped virtual disk, in sectors, and its stripe size
+int P2_StripeSize(int *sectors, int *stripe) {
+	checkIfIsKernel();
+	if (sectors == NULL || stripe == NULL) return P2_NULL_ADDRESS;
+	*sectors = stripeCapacity();
+	*stripe = stripeSectors;
+	return P1_SUCCESS;
+}
+
+/*
+ * Mirrored virtual disk (RAID-1). Every write goes to both mirrorUnits, every read to
+ * just one of them, so two processes reading the mirror keep both heads busy. The
+ * mirror is addressed like a unit and is as large as the smaller of the two.
+ */
+
+/*
+ * P2DiskSetMirror
+ *
+ * Selects the two units that hold the mirrored virtual disk. Must be called before
+ * P2DiskInit; by default units 0 and 1 are used.
+ */
+int
+P2DiskSetMirror(int primary, int secondary)
+{
+	checkIfIsKernel();
+	if (primary < 0 || primary >= USLOSS_DISK_UNITS || secondary < 0 ||
+		secondary >= USLOSS_DISK_UNITS || primary == secondary) {
+		return P1_INVALID_UNIT;
+	}
+	if (initialized) return P1_INVALID_STATE;
+	mirrorUnits[0] = primary;
+	mirrorUnits[1] = secondary;
+	return P1_SUCCESS;
+}
+
+// returns the number of tracks on the mirrored virtual disk
+static int mirrorTracks(void) {
+	int a = NUM_TRACKS[mirrorUnits[0]], b = NUM_TRACKS[mirrorUnits[1]];
+	return a < b ? a : b;
+}
+
+// checks the arguments of a mirrored transfer
+static int checkMirror(int track, int first, int sectors, void *buffer) {
+	if (mirrorUnits[0] >= numDisks || mirrorUnits[1] >= numDisks) return P1_INVALID_UNIT;
+	if (track < 0 || track >= mirrorTracks()) return P2_INVALID_TRACK;
+	if (first < 0 || first >= USLOSS_DISK_TRACK_SIZE) return P2_INVALID_FIRST;
+	if (sectors < 0 ||
+		track * USLOSS_DISK_TRACK_SIZE + first + sectors > mirrorTracks() * USLOSS_DISK_TRACK_SIZE) {
+		return P2_INVALID_SECTORS;
+	}
+	if (buffer == NULL) return P2_NULL_ADDRESS;
+	return P1_SUCCESS;
+}
+
+// returns which copy (0 or 1) should serve a read of a track: the one with fewer
+// requests queued, or on a tie the one whose head is closer to the track
+static int mirrorChoose(int track) {
+	int i, depth[2], distance[2];
+	for (i = 0; i < 2; i++) {
+		int unit = mirrorUnits[i];
+		P(mutex[unit]);
+		depth[i] = stats[unit].queueDepth;
+		distance[i] = headTrack[unit] < 0 ? NUM_TRACKS[unit] : abs(track - headTrack[unit]);
+		V(mutex[unit]);
+	}
+	if (depth[0] != depth[1]) return depth[1] < depth[0];
+	return distance[1] < distance[0];
+}
+
+/*
+ * P2_MirrorRead
+ *
+ * Reads sectors from the mirrored virtual disk. If the chosen copy fails the read is
+ * retried on the other one.
+ */
+int
+P2_MirrorRead(int track, int first, int sectors, void *buffer)
+{
+	checkIfIsKernel();
+	int rc = checkMirror(track, first, sectors, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	int copy = mirrorChoose(track);
+	rc = waitRequest(submitRequest(USLOSS_DISK_READ, mirrorUnits[copy], track, first, sectors,
+								   buffer));
+	if (rc != P1_SUCCESS) {
+		copy = !copy;
+		rc = waitRequest(submitRequest(USLOSS_DISK_READ, mirrorUnits[copy], track, first,
+									   sectors, buffer));
+	}
+	if (rc == P1_SUCCESS) {
+		P(mutex[mirrorUnits[copy]]);
+		mirrorReads[copy]++;
+		V(mutex[mirrorUnits[copy]]);
+	}
+	return rc;
+}
+
+/*
+ * P2_MirrorWrite
+ *
+ * Writes sectors to both copies of the mirrored virtual disk at once and waits for
+ * both writes.
+ */
+int
+P2_MirrorWrite(int track, int first, int sectors, void *buffer)
+{
+	checkIfIsKernel();
+	int rc = checkMirror(track, first, sectors, buffer);
+	if (rc != P1_SUCCESS) return rc;
+	Request *primary = submitRequest(USLOSS_DISK_WRITE, mirrorUnits[0], track, first, sectors,
+									 buffer);
+	Request *secondary = submitRequest(USLOSS_DISK_WRITE, mirrorUnits[1], track, first, sectors,
+									   buffer);
+	rc = waitRequest(primary);
+	int rc2 = waitRequest(secondary);
+	return rc != P1_SUCCESS ? rc : rc2;
+}
+
+// returns the number of tracks on the mirrored virtual disk and how many reads each copy served
+int P2_MirrorStats(int *tracks, int *primaryReads, int *secondaryReads) {
+	checkIfIsKernel();
+	if (tracks == NULL || primaryReads == NULL || secondaryReads == NULL) return P2_NULL_ADDRESS;
+	if (mirrorUnits[0] >= numDisks || mirrorUnits[1] >= numDisks) return P1_INVALID_UNIT;
+	*tracks = mirrorTracks();
+	P(mutex[mirrorUnits[0]]);
+	*primaryReads = mirrorReads[0];
+	V(mutex[mirrorUnits[0]]);
+	P(mutex[mirrorUnits[1]]);
+	*secondaryReads = mirrorReads[1];
+	V(mutex[mirrorUnits[1]]);
+	return P1_SUCCESS;
+}
+
+// returns the unit's allocator header, the start of its image
+#define ALLOC_HEADER(unit) ((AllocHeader *) allocImage[unit])
+#define ALLOC_BITS(unit) ((unsigned char *) (allocImage[unit] + sizeof(AllocHeader)))
+
+static int allocIsSet(int unit, int sector) {
+	return (ALLOC_BITS(unit)[sector / 8] >> (sector % 8)) & 1;
+}
+
+// marks sectors allocated or free and keeps the per-track counts in step
+static void allocMark(int unit, int start, int sectors, int allocated) {
+	int sector;
+	for (sector = start; sector < start + sectors; sector++) {
+		if (allocated) {
+			ALLOC_BITS(unit)[sector / 8] |= 1 << (sector % 8);
+		} else {
+			ALLOC_BITS(unit)[sector / 8] &= ~(1 << (sector % 8));
+		}
+	}
+	for (sector = start; sector < start + sectors; sector++) {
+		trackFree[unit][sector / USLOSS_DISK_TRACK_SIZE] += allocated ? -1 : 1;
+	}
+}
+
+// writes the image sectors holding the bits of a range of sectors back to the unit
+static int allocSave(int unit, int start, int sectors) {
+	int first = (sizeof(AllocHeader) + start / 8) / USLOSS_DISK_SECTOR_SIZE;
+	int last = (sizeof(AllocHeader) + (start + sectors - 1) / 8) / USLOSS_DISK_SECTOR_SIZE;
+	return P2_DiskWrite(unit, first / USLOSS_DISK_TRACK_SIZE, first % USLOSS_DISK_TRACK_SIZE,
+						last - first + 1, allocImage[unit] + first * USLOSS_DISK_SECTOR_SIZE);
+}
+
+/*
+ * allocLoad
+ *
+ * Reads the unit's allocator image the first time the unit is used, or formats the unit
+ * if it does not have one yet. allocMutex[unit] must be held.
+ */
+static int
+allocLoad(int unit)
+{
+	int rc, track, sector;
+	if (allocLoaded[unit]) return P1_SUCCESS;
+	AllocHeader *header = ALLOC_HEADER(unit);
+	int sectors = NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE;
+	if (sectors > ALLOC_MAX_SECTORS) sectors = ALLOC_MAX_SECTORS;
+	int headerSectors = (sizeof(AllocHeader) + (sectors + 7) / 8 + USLOSS_DISK_SECTOR_SIZE - 1) /
+						USLOSS_DISK_SECTOR_SIZE;
+	rc = P2_DiskRead(unit, 0, 0, headerSectors, allocImage[unit]);
+	if (rc != P1_SUCCESS) return rc;
+	if (header->magic != ALLOC_MAGIC || header->sectors != sectors ||
+		header->headerSectors != headerSectors) {
+		memset(allocImage[unit], 0, sizeof(allocImage[unit]));
+		header->magic = ALLOC_MAGIC;
+		header->sectors = sectors;
+		header->headerSectors = headerSectors;
+		for (sector = 0; sector < headerSectors; sector++) {
+			ALLOC_BITS(unit)[sector / 8] |= 1 << (sector % 8);
+		}
+		rc = P2_DiskWrite(unit, 0, 0, headerSectors, allocImage[unit]);
+		if (rc != P1_SUCCESS) return rc;
+	}
+	for (track = 0; track * USLOSS_DISK_TRACK_SIZE < sectors; track++) {
+		trackFree[unit][track] = 0;
+	}
+	for (sector = 0; sector < sectors; sector++) {
+		if (!allocIsSet(unit, sector)) trackFree[unit][sector / USLOSS_DISK_TRACK_SIZE]++;
+	}
+	allocLoaded[unit] = TRUE;
+	return P1_SUCCESS;
+}
+
+// returns the first sector of a free run of the given length between from and to, or -1.
+// Runs must start on a track boundary if aligned is set and may not cross into the next
+// track if withinTrack is set.
+static int allocFind(int unit, int sectors, int from, int to, int aligned, int withinTrack) {
+	int start, run = 0;
+	for (start = from; start < to; start++) {
+		int track = start / USLOSS_DISK_TRACK_SIZE;
+		if (start % USLOSS_DISK_TRACK_SIZE == 0) {
+			if (withinTrack) run = 0;
+			// skip full tracks without looking at their bits
+			if (trackFree[unit][track] == 0) {
+				run = 0;
+				start += USLOSS_DISK_TRACK_SIZE - 1;
+				continue;
+			}
+		}
+		if (allocIsSet(unit, start) || (aligned && run == 0 && start % USLOSS_DISK_TRACK_SIZE != 0)) {
+			run = 0;
+			continue;
+		}
+		if (++run == sectors) return start - sectors + 1;
+	}
+	return -1;
+}
+
+/*
+ * P2_DiskAlloc
+ *
+ * Allocates a contiguous extent of sectors on a unit and returns where it starts.
+ * Extents of a track or more start on a track boundary; smaller ones are fitted inside a
+ * single track, in a track that is already partly used if possible so that whole tracks
+ * stay free for large extents. Only if neither works does the extent cross a track
+ * boundary. Returns P2_NO_SPACE if there is no free run long enough.
+ */
+int
+P2_DiskAlloc(int unit, int sectors, int *track, int *first)
+{
+	checkIfIsKernel();
+	int rc, start = -1, t;
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	if (track == NULL || first == NULL) return P2_NULL_ADDRESS;
+	if (sectors <= 0) return P2_INVALID_SECTORS;
+	P(allocMutex[unit]);
+	rc = allocLoad(unit);
+	if (rc != P1_SUCCESS) {
+		V(allocMutex[unit]);
+		return rc;
+	}
+	int total = ALLOC_HEADER(unit)->sectors;
+	if (sectors >= USLOSS_DISK_TRACK_SIZE) {
+		start = allocFind(unit, sectors, 0, total, TRUE, FALSE);
+	} else {
+		for (t = 0; start == -1 && t * USLOSS_DISK_TRACK_SIZE < total; t++) {
+			if (trackFree[unit][t] >= sectors && trackFree[unit][t] < USLOSS_DISK_TRACK_SIZE) {
+				start = allocFind(unit, sectors, t * USLOSS_DISK_TRACK_SIZE,
+								  (t + 1) * USLOSS_DISK_TRACK_SIZE, FALSE, TRUE);
+			}
+		}
+		if (start == -1) start = allocFind(unit, sectors, 0, total, FALSE, TRUE);
+	}
+	if (start == -1) start = allocFind(unit, sectors, 0, total, FALSE, FALSE);
+	if (start == -1) {
+		rc = P2_NO_SPACE;
+	} else {
+		allocMark(unit, start, sectors, TRUE);
+		rc = allocSave(unit, start, sectors);
+		if (rc == P1_SUCCESS) {
+			*track = start / USLOSS_DISK_TRACK_SIZE;
+			*first = start % USLOSS_DISK_TRACK_SIZE;
+		} else {
+			allocMark(unit, start, sectors, FALSE);
+		}
+	}
+	V(allocMutex[unit]);
+	return rc;
+}
+
+/*
+ * P2_DiskFree
+ *
+ * Returns an extent allocated by P2_DiskAlloc to the unit's free space. Every sector of
+ * it must be allocated.
+ */
+int
+P2_DiskFree(int unit, int track, int first, int sectors)
+{
+	checkIfIsKernel();
+	int rc, sector;
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	if (first < 0 || first >= USLOSS_DISK_TRACK_SIZE) return P2_INVALID_FIRST;
+	P(allocMutex[unit]);
+	rc = allocLoad(unit);
+	int start = track * USLOSS_DISK_TRACK_SIZE + first;
+	if (rc == P1_SUCCESS && (track < 0 || start < ALLOC_HEADER(unit)->headerSectors ||
+							 start >= ALLOC_HEADER(unit)->sectors)) {
+		rc = P2_INVALID_TRACK;
+	}
+	if (rc == P1_SUCCESS && (sectors <= 0 || start + sectors > ALLOC_HEADER(unit)->sectors)) {
+		rc = P2_INVALID_SECTORS;
+	}
+	for (sector = start; rc == P1_SUCCESS && sector < start + sectors; sector++) {
+		if (!allocIsSet(unit, sector)) rc = P2_INVALID_SECTORS;
+	}
+	if (rc == P1_SUCCESS) {
+		allocMark(unit, start, sectors, FALSE);
+		rc = allocSave(unit, start, sectors);
+	}
+	V(allocMutex[unit]);
+	return rc;
+}
+
+// stub for P2_DiskAlloc
+static void
+DiskAllocStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	int track = -1, first = -1;
+	sysargs->arg4 = (void*) P2_DiskAlloc((int) sysargs->arg5, (int) sysargs->arg1, &track, &first);
+	sysargs->arg2 = (void*) track;
+	sysargs->arg3 = (void*) first;
+}
+
+// stub for P2_DiskFree
+static void
+DiskFreeStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskFree((int) sysargs->arg5, (int) sysargs->arg2,
+										(int) sysargs->arg3, (int) sysargs->arg1);
+}
+
+/*
+ * Byte-addressed transfers. Byte offset o of a unit is byte o % USLOSS_DISK_SECTOR_SIZE of
+ * sector o / USLOSS_DISK_SECTOR_SIZE, counted from the start of the unit. A transfer is
+ * served as one vectored request: the whole sectors go straight between the disk and the
+ * caller's buffer, and a partly covered first or last sector goes through the caller's
+ * bounce buffers.
+ */
+
+// checks the arguments of a byte transfer
+static int checkBytes(int unit, int offset, int len, void *buffer) {
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	int size = NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE * USLOSS_DISK_SECTOR_SIZE;
+	if (offset < 0 || offset > size) return P2_INVALID_FIRST;
+	if (len < 0 || len > size - offset) return P2_INVALID_SECTORS;
+	if (buffer == NULL) return P2_NULL_ADDRESS;
+	return P1_SUCCESS;
+}
+
+static void setSegment(P2_DiskSegment *segment, int sector, int sectors, void *buffer) {
+	segment->track = sector / USLOSS_DISK_TRACK_SIZE;
+	segment->first = sector % USLOSS_DISK_TRACK_SIZE;
+	segment->sectors = sectors;
+	segment->buffer = buffer;
+}
+
+/*
+ * byteSegments
+ *
+ * Splits a byte range of len > 0 bytes into at most three segments in sector order: a
+ * partly covered first sector read into bounce[pid][0], the whole sectors, and a partly
+ * covered last sector read into bounce[pid][1]. Returns the number of segments and
+ * whether the first and last sectors are partial.
+ */
+static int
+byteSegments(int offset, int len, void *buffer, P2_DiskSegment *segments, int *head, int *tail)
+{
+	int pid = P1_GetPid(), n = 0, end = offset + len;
+	int first = offset / USLOSS_DISK_SECTOR_SIZE, last = (end - 1) / USLOSS_DISK_SECTOR_SIZE;
+	*head = offset % USLOSS_DISK_SECTOR_SIZE != 0 ||
+			end - first * USLOSS_DISK_SECTOR_SIZE < USLOSS_DISK_SECTOR_SIZE;
+	*tail = last > first && end % USLOSS_DISK_SECTOR_SIZE != 0;
+	if (*head) setSegment(&segments[n++], first, 1, bounce[pid][0]);
+	int lo = first + *head, hi = last - *tail;
+	if (hi >= lo) {
+		setSegment(&segments[n++], lo, hi - lo + 1,
+				   buffer + lo * USLOSS_DISK_SECTOR_SIZE - offset);
+	}
+	if (*tail) setSegment(&segments[n++], last, 1, bounce[pid][1]);
+	return n;
+}
+
+// runs a vectored transfer on a unit and waits for it, returning the first failure
+static int byteTransfer(int type, int unit, P2_DiskSegment *segments, int count) {
+	int status[3], i;
+	for (i = 0; i < count; i++) status[i] = P1_SUCCESS;
+	int rc = waitRequest(submitVector(type, unit, segments, count, status));
+	for (i = 0; i < count; i++) {
+		if (rc == P1_SUCCESS) rc = status[i];
+	}
+	return rc;
+}
+
+/*
+ * P2_DiskPread
+ *
+ * Reads len bytes starting at a byte offset of a unit into buffer.
+ */
+int
+P2_DiskPread(int unit, int offset, int len, void *buffer)
+{
+	checkIfIsKernel();
+	P2_DiskSegment segments[3];
+	int head, tail, pid = P1_GetPid();
+	int rc = checkBytes(unit, offset, len, buffer);
+	if (rc != P1_SUCCESS || len == 0) return rc;
+	int n = byteSegments(offset, len, buffer, segments, &head, &tail);
+	rc = byteTransfer(USLOSS_DISK_READ, unit, segments, n);
+	if (rc != P1_SUCCESS) return rc;
+	int skip = offset % USLOSS_DISK_SECTOR_SIZE, end = offset + len;
+	if (head) {
+		int bytes = USLOSS_DISK_SECTOR_SIZE - skip < len ? USLOSS_DISK_SECTOR_SIZE - skip : len;
+		memcpy(buffer, bounce[pid][0] + skip, bytes);
+	}
+	if (tail) {
+		int bytes = end % USLOSS_DISK_SECTOR_SIZE;
+		memcpy(buffer + len - bytes, bounce[pid][1], bytes);
+	}
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskPwrite
+ *
+ * Writes len bytes from buffer starting at a byte offset of a unit. A partly covered
+ * first or last sector is read, merged with the new bytes and written back; concurrent
+ * P2_DiskPwrite calls on the unit do not lose each other's bytes in a shared sector.
+ */
+int
+P2_DiskPwrite(int unit, int offset, int len, void *buffer)
+{
+	checkIfIsKernel();
+	P2_DiskSegment segments[3], partial[2];
+	int head, tail, pid = P1_GetPid();
+	int rc = checkBytes(unit, offset, len, buffer);
+	if (rc != P1_SUCCESS || len == 0) return rc;
+	int n = byteSegments(offset, len, buffer, segments, &head, &tail);
+	if (!head && !tail) return byteTransfer(USLOSS_DISK_WRITE, unit, segments, n);
+
+	P(partialMutex[unit]);
+	int count = 0;
+	if (head) partial[count++] = segments[0];
+	if (tail) partial[count++] = segments[n - 1];
+	rc = byteTransfer(USLOSS_DISK_READ, unit, partial, count);
+	if (rc == P1_SUCCESS) {
+		int skip = offset % USLOSS_DISK_SECTOR_SIZE, end = offset + len;
+		if (tail) {
+			int bytes = end % USLOSS_DISK_SECTOR_SIZE;
+			memcpy(bounce[pid][1], buffer + len - bytes, bytes);
+		}
+		if (head) {
+			int bytes = USLOSS_DISK_SECTOR_SIZE - skip < len ? USLOSS_DISK_SECTOR_SIZE - skip : len;
+			memcpy(bounce[pid][0] + skip, buffer, bytes);
+		}
+		rc = byteTransfer(USLOSS_DISK_WRITE, unit, segments, n);
+	}
+	V(partialMutex[unit]);
+	return rc;
+}
+
+// stub for P2_DiskPread
+static void
+DiskPreadStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskPread((int) sysargs->arg5, (int) sysargs->arg3,
+										 (int) sysargs->arg2, sysargs->arg1);
+}
+
+// stub for P2_DiskPwrite
+static void
+DiskPwriteStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskPwrite((int) sysargs->arg5, (int) sysargs->arg3,
+										  (int) sysargs->arg2, sysargs->arg1);
+}
+
+// checks a range of sectors on a unit
+static int checkRange(int unit, int track, int first, int sectors) {
+	int rc = checkRequest(unit, track, first, (void *) 1);
+	if (rc != P1_SUCCESS) return rc;
+	if (sectors < 0 ||
+		track * USLOSS_DISK_TRACK_SIZE + first + sectors > NUM_TRACKS[unit] * USLOSS_DISK_TRACK_SIZE) {
+		return P2_INVALID_SECTORS;
+	}
+	return P1_SUCCESS;
+}
+
+// takes a free pair of chunk buffers, blocking until there is one
+static int copyAcquire(void) {
+	int slot;
+	P(copySlots);
+	P(copyMutex);
+	for (slot = 0; copyInUse[slot]; slot++) {
+	}
+	copyInUse[slot] = TRUE;
+	V(copyMutex);
+	return slot;
+}
+
+static void copyRelease(int slot) {
+	P(copyMutex);
+	copyInUse[slot] = FALSE;
+	V(copyMutex);
+	V(copySlots);
+}
+
+// queues a transfer of chunk i of a range, from or into one of a slot's buffers
+static Request *copyChunk(int type, int unit, int start, int sectors, int i, int chunks,
+						  int backward, char *buffer) {
+	int chunk = backward ? chunks - 1 - i : i;
+	int offset = chunk * COPY_CHUNK;
+	int n = sectors - offset < COPY_CHUNK ? sectors - offset : COPY_CHUNK;
+	return submitRequest(type, unit, (start + offset) / USLOSS_DISK_TRACK_SIZE,
+						 (start + offset) % USLOSS_DISK_TRACK_SIZE, n, buffer);
+}
+
+/*
+ * P2_DiskCopy
+ *
+ * Copies sectors from one place to another, on the same unit or between units. The copy
+ * goes a chunk at a time through kernel buffers, and the read of each chunk is queued as
+ * soon as the write that last used its buffer is done, so the source unit's driver reads
+ * ahead while the destination unit's driver writes. Overlapping ranges on one unit are
+ * copied as if through a temporary buffer.
+ */
+int
+P2_DiskCopy(int srcUnit, int srcTrack, int srcFirst, int dstUnit, int dstTrack, int dstFirst,
+			int sectors)
+{
+	checkIfIsKernel();
+	Request *reads[2] = {NULL, NULL}, *writes[2] = {NULL, NULL};
+	int i, rc2;
+	int rc = checkRange(srcUnit, srcTrack, srcFirst, sectors);
+	if (rc == P1_SUCCESS) rc = checkRange(dstUnit, dstTrack, dstFirst, sectors);
+	if (rc != P1_SUCCESS || sectors == 0) return rc;
+	int src = srcTrack * USLOSS_DISK_TRACK_SIZE + srcFirst;
+	int dst = dstTrack * USLOSS_DISK_TRACK_SIZE + dstFirst;
+	// copy from the end if the destination starts inside the source
+	int backward = srcUnit == dstUnit && dst > src && dst < src + sectors;
+	int chunks = (sectors + COPY_CHUNK - 1) / COPY_CHUNK;
+	int slot = copyAcquire();
+	char (*buffers)[COPY_CHUNK * USLOSS_DISK_SECTOR_SIZE] = copyBuffers[slot];
+
+	reads[0] = copyChunk(USLOSS_DISK_READ, srcUnit, src, sectors, 0, chunks, backward, buffers[0]);
+	for (i = 0; i < chunks; i++) {
+		rc2 = waitRequest(reads[i % 2]);
+		reads[i % 2] = NULL;
+		if (rc == P1_SUCCESS) rc = rc2;
+		if (rc != P1_SUCCESS) break;
+		writes[i % 2] = copyChunk(USLOSS_DISK_WRITE, dstUnit, dst, sectors, i, chunks, backward,
+								  buffers[i % 2]);
+		if (i + 1 < chunks) {
+			// the next chunk's buffer is free once the write from it is done. In the order
+			// the chunks go, no queued write lands on a chunk that is still to be read.
+			if (writes[(i + 1) % 2] != NULL) {
+				rc2 = waitRequest(writes[(i + 1) % 2]);
+				writes[(i + 1) % 2] = NULL;
+				if (rc == P1_SUCCESS) rc = rc2;
+			}
+			if (rc != P1_SUCCESS) break;
+			reads[(i + 1) % 2] = copyChunk(USLOSS_DISK_READ, srcUnit, src, sectors, i + 1, chunks,
+										   backward, buffers[(i + 1) % 2]);
+		}
+	}
+	for (i = 0; i < 2; i++) {
+		if (reads[i] != NULL) waitRequest(reads[i]);
+		if (writes[i] != NULL) {
+			rc2 = waitRequest(writes[i]);
+			if (rc == P1_SUCCESS) rc = rc2;
+		}
+	}
+	copyRelease(slot);
+	return rc;
+}
+
+/*
+ * P2_DiskFill
+ *
+ * Writes the same sector of data, pattern, to every sector of a range. Two chunk writes
+ * are kept queued at a time.
+ */
+int
+P2_DiskFill(int unit, int track, int first, int sectors, void *pattern)
+{
+	checkIfIsKernel();
+	Request *writes[2] = {NULL, NULL};
+	int i, rc2;
+	int rc = checkRange(unit, track, first, sectors);
+	if (rc == P1_SUCCESS && pattern == NULL) rc = P2_NULL_ADDRESS;
+	if (rc != P1_SUCCESS || sectors == 0) return rc;
+	int start = track * USLOSS_DISK_TRACK_SIZE + first;
+	int chunks = (sectors + COPY_CHUNK - 1) / COPY_CHUNK;
+	int slot = copyAcquire();
+	char *buffer = copyBuffers[slot][0];
+	for (i = 0; i < COPY_CHUNK; i++) {
+		memcpy(buffer + i * USLOSS_DISK_SECTOR_SIZE, pattern, USLOSS_DISK_SECTOR_SIZE);
+	}
+	for (i = 0; i < chunks; i++) {
+		if (writes[i % 2] != NULL) {
+			rc2 = waitRequest(writes[i % 2]);
+			if (rc == P1_SUCCESS) rc = rc2;
+		}
+		writes[i % 2] = copyChunk(USLOSS_DISK_WRITE, unit, start, sectors, i, chunks, FALSE, buffer);
+	}
+	for (i = 0; i < 2; i++) {
+		if (writes[i] != NULL) {
+			rc2 = waitRequest(writes[i]);
+			if (rc == P1_SUCCESS) rc = rc2;
+		}
+	}
+	copyRelease(slot);
+	return rc;
+}
+
+// stub for P2_DiskCopy, the sources and destination are passed as sectors from the
+// start of their units
+static void
+DiskCopyStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	int src = (int) sysargs->arg2, dst = (int) sysargs->arg3;
+	sysargs->arg4 = (void*) P2_DiskCopy((int) sysargs->arg1, src / USLOSS_DISK_TRACK_SIZE,
+										src % USLOSS_DISK_TRACK_SIZE, (int) sysargs->arg5,
+										dst / USLOSS_DISK_TRACK_SIZE, dst % USLOSS_DISK_TRACK_SIZE,
+										(int) sysargs->arg4);
 }
 
-// helper function handling moving the disk track synchronously
+// stub for P2_DiskFill
+static void
+DiskFillStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskFill((int) sysargs->arg5, (int) sysargs->arg3,
+										(int) sysargs->arg4, (int) sysargs->arg2, sysargs->arg1);
+}
+
+// helper function handling moving the disk track synchronously. The seek is skipped if
+// the head is already on the track, e.g. when a request starts where the previous one
+// (or the previous track of a multi-track request) left off.
 void moveTrack(int track, int unit) {
 	int rc;
+	if (!planSeek(track, unit)) return;
 	USLOSS_DeviceRequest request;
 	request.opr = USLOSS_DISK_SEEK;
 	request.reg1 = (void*) track;
@@ -280,6 +2860,19 @@ void moveTrack(int track, int unit) {
 	assert(rc == P1_SUCCESS);
 }
 
+// counts a move of the head to a track and returns whether it needs a seek. The head is
+// taken to be on the track from now on.
+static int planSeek(int track, int unit) {
+	if (headTrack[unit] == track) {
+		seeksElided[unit]++;
+		return FALSE;
+	}
+	seeksIssued[unit]++;
+	tracksTraveled[unit] += headTrack[unit] < 0 ? track : abs(track - headTrack[unit]);
+	headTrack[unit] = track;
+	return TRUE;
+}
+
 // helper function handling read and write synchronously 
 void completeReadWriteAt(int type, int sector, int unit, void *buffer) {
 	int rc;
@@ -307,6 +2900,110 @@ int P2_DiskSize(int unit, int *sector, int *track, int *disk){
 	return rc;
 }
 
+/*
+ * P2_DiskStats
+ *
+ * Copies a unit's counters and latency histograms into *info.
+ */
+int
+P2_DiskStats(int unit, P2_DiskStatistics *info)
+{
+	checkIfIsKernel();
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	if (info == NULL) return P2_NULL_ADDRESS;
+	P(mutex[unit]);
+	*info = stats[unit];
+	info->seeks = seeksIssued[unit];
+	V(mutex[unit]);
+	return P1_SUCCESS;
+}
+
+// stub for P2_DiskStats
+static void
+DiskStatsStub(USLOSS_Sysargs *sysargs)
+{
+	checkIfIsKernel();
+	sysargs->arg4 = (void*) P2_DiskStats((int) sysargs->arg1, sysargs->arg2);
+}
+
+/*
+ * P2DiskSetTrace
+ *
+ * Turns on request tracing with a ring of the given number of entries, up to
+ * P2_DISK_TRACE_MAX, or turns it off with 0. Must be called before P2DiskInit.
+ */
+int
+P2DiskSetTrace(int entries)
+{
+	checkIfIsKernel();
+	if (entries < 0 || entries > P2_DISK_TRACE_MAX) return P2_INVALID_SECTORS;
+	if (initialized) return P1_INVALID_STATE;
+	traceSize = entries;
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskTraceRead
+ *
+ * Copies up to max entries of the trace into entries, oldest first, and returns how
+ * many were copied in count.
+ */
+int
+P2_DiskTraceRead(P2_DiskTraceEntry *entries, int max, int *count)
+{
+	checkIfIsKernel();
+	int i;
+	if (entries == NULL || count == NULL) return P2_NULL_ADDRESS;
+	if (max < 0) return P2_INVALID_SECTORS;
+	*count = 0;
+	if (traceSize == 0) return P1_SUCCESS;
+	P(traceMutex);
+	int oldest = (traceNext - traceCount + traceSize) % traceSize;
+	for (i = 0; i < traceCount && i < max; i++) {
+		entries[i] = trace[(oldest + i) % traceSize];
+	}
+	*count = i;
+	V(traceMutex);
+	return P1_SUCCESS;
+}
+
+/*
+ * P2_DiskTraceDump
+ *
+ * Prints the trace on the console, oldest entry first, one line per request:
+ *
+ *  TRACE time=<us> pid=<pid> unit=<unit> type=<read|write> track=<track> first=<first>
+ *        sectors=<sectors> latency=<us>
+ */
+void
+P2_DiskTraceDump(void)
+{
+	checkIfIsKernel();
+	int i;
+	if (traceSize == 0) return;
+	P(traceMutex);
+	int oldest = (traceNext - traceCount + traceSize) % traceSize;
+	for (i = 0; i < traceCount; i++) {
+		P2_DiskTraceEntry *entry = &trace[(oldest + i) % traceSize];
+		USLOSS_Console("TRACE time=%d pid=%d unit=%d type=%s track=%d first=%d sectors=%d "
+					   "latency=%d\n", entry->time, entry->pid, entry->unit,
+					   entry->type == USLOSS_DISK_READ ? "read" : "write", entry->track,
+					   entry->first, entry->sectors, entry->latency);
+	}
+	V(traceMutex);
+}
+
+// returns the seek counters for a unit
+int P2_DiskSeekStats(int unit, int *issued, int *elided, int *traveled) {
+	checkIfIsKernel();
+	if (unit < 0 || unit >= numDisks) return P1_INVALID_UNIT;
+	if (issued == NULL || elided == NULL || traveled == NULL) return P2_NULL_ADDRESS;
+	*issued = seeksIssued[unit];
+	*elided = seeksElided[unit];
+	*traveled = tracksTraveled[unit];
+	return P1_SUCCESS;
+}
+
 // stub for disk size
 static void 
 DiskSizeStub(USLOSS_Sysargs *sysargs) 
@@ -0,0 +1,163 @@
+/*
+ * bench.h
+ *
+ * Helpers shared by the disk benchmarks (test_bench_*.c). Every measured run prints
+ * one line on the console:
+ *
+ *  BENCH <name> unit=<unit> tracks=<tracks> ops=<n> sectors=<n> us=<n> ops_per_sec=<n>
+ *        sectors_per_sec=<n> seeks_per_op=<n.nn> p50_us=<n> p90_us=<n> p99_us=<n>
+ *
+ * The fields are always printed in this order. The latency percentiles come from the
+ * P2_DiskStats latency histogram, so each one is the upper bound of the power-of-two
+ * bucket it falls in.
+ */
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <assert.h>
+#include <usloss.h>
+
+#include "phase2Ext.h"
+
+#define BENCH_READ      0
+#define BENCH_WRITE     1
+#define BENCH_MIXED     2   // two reads for every write, chosen at random
+
+#define BENCH_MAX_SECTORS   (4*USLOSS_DISK_TRACK_SIZE)  // largest request size
+
+typedef struct BenchRun {
+    int                 unit;
+    int                 start;  // clock time, in microseconds
+    P2_DiskStatistics   before;
+} BenchRun;
+
+static unsigned int benchSeed = 1;
+
+// returns a pseudo-random number in [0, n), the same sequence on every run
+static int
+BenchRandom(int n)
+{
+    benchSeed = benchSeed * 1103515245 + 12345;
+    return (benchSeed >> 16) % n;
+}
+
+static int
+BenchNow(void)
+{
+    int now;
+    int rc = USLOSS_DeviceInput(USLOSS_CLOCK_DEV, 0, &now);
+    assert(rc == USLOSS_DEV_OK);
+    return now;
+}
+
+static int
+BenchTracks(int unit)
+{
+    int sector, track, disk;
+    int rc = P2_DiskSize(unit, &sector, &track, &disk);
+    assert(rc == P1_SUCCESS);
+    return disk;
+}
+
+/*
+ * BenchLoad
+ *
+ * Issues ops requests of the given number of sectors on a unit. Sequential runs start
+ * at sector start and wrap around at the end of the disk; random runs pick a start
+ * anywhere the request fits. Returns the first error, or P1_SUCCESS.
+ */
+static int
+BenchLoad(int unit, int mode, int sequential, int ops, int sectors, int start, char *buffer)
+{
+    int i, rc, type;
+    int total = BenchTracks(unit) * USLOSS_DISK_TRACK_SIZE;
+    int next = start % (total - sectors + 1);
+
+    assert(sectors > 0 && sectors <= BENCH_MAX_SECTORS);
+    for (i = 0; i < ops; i++) {
+        int sector = sequential ? next : BenchRandom(total - sectors + 1);
+        next = sector + sectors > total - sectors ? 0 : sector + sectors;
+        type = mode == BENCH_MIXED ? (BenchRandom(3) == 0 ? BENCH_WRITE : BENCH_READ) : mode;
+        if (type == BENCH_READ) {
+            rc = P2_DiskRead(unit, sector / USLOSS_DISK_TRACK_SIZE,
+                             sector % USLOSS_DISK_TRACK_SIZE, sectors, buffer);
+        } else {
+            rc = P2_DiskWrite(unit, sector / USLOSS_DISK_TRACK_SIZE,
+                              sector % USLOSS_DISK_TRACK_SIZE, sectors, buffer);
+        }
+        if (rc != P1_SUCCESS) {
+            return rc;
+        }
+    }
+    return P1_SUCCESS;
+}
+
+static void
+BenchBegin(int unit, BenchRun *run)
+{
+    int rc = P2_DiskStats(unit, &run->before);
+    assert(rc == P1_SUCCESS);
+    run->unit = unit;
+    run->start = BenchNow();
+}
+
+// returns the latency, in microseconds, below which percent of the run's requests fell
+static int
+BenchPercentile(P2_DiskStatistics *before, P2_DiskStatistics *after, int percent)
+{
+    int i, total = 0, seen = 0;
+
+    for (i = 0; i < P2_DISK_HIST_BUCKETS; i++) {
+        total += after->latency[i] - before->latency[i];
+    }
+    for (i = 0; i < P2_DISK_HIST_BUCKETS; i++) {
+        seen += after->latency[i] - before->latency[i];
+        if (seen * 100 >= total * percent) {
+            break;
+        }
+    }
+    return 1 << (i < P2_DISK_HIST_BUCKETS ? i + 1 : P2_DISK_HIST_BUCKETS);
+}
+
+// prints the BENCH line for a run that issued ops requests moving sectors sectors in all
+static void
+BenchEnd(BenchRun *run, char *name, int ops, int sectors)
+{
+    P2_DiskStatistics after;
+    int rc = P2_DiskStats(run->unit, &after);
+    assert(rc == P1_SUCCESS);
+    long long us = BenchNow() - run->start;
+    if (us <= 0) {
+        us = 1;
+    }
+    int seeks100 = ops > 0 ? (after.seeks - run->before.seeks) * 100 / ops : 0;
+    USLOSS_Console("BENCH %s unit=%d tracks=%d ops=%d sectors=%d us=%lld ops_per_sec=%lld "
+                   "sectors_per_sec=%lld seeks_per_op=%d.%02d p50_us=%d p90_us=%d p99_us=%d\n",
+                   name, run->unit, BenchTracks(run->unit), ops, sectors, us,
+                   ops * 1000000LL / us, sectors * 1000000LL / us, seeks100 / 100, seeks100 % 100,
+                   BenchPercentile(&run->before, &after, 50),
+                   BenchPercentile(&run->before, &after, 90),
+                   BenchPercentile(&run->before, &after, 99));
+}
+
+/*
+ * BenchMeasure
+ *
+ * Runs BenchLoad from the calling process and prints its BENCH line.
+ */
+static int
+BenchMeasure(char *name, int unit, int mode, int sequential, int ops, int sectors)
+{
+    static char buffer[BENCH_MAX_SECTORS * USLOSS_DISK_SECTOR_SIZE];
+    BenchRun run;
+
+    BenchBegin(unit, &run);
+    int rc = BenchLoad(unit, mode, sequential, ops, sectors, 0, buffer);
+    if (rc == P1_SUCCESS) {
+        BenchEnd(&run, name, ops, ops * sectors);
+    }
+    return rc;
+}
+
+#endif
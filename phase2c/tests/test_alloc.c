@@ -0,0 +1,89 @@
+/*
+ * test_alloc.c
+ *
+ * Allocates and frees extents on a 10-track unit and checks where they land: large
+ * extents on track boundaries, small ones packed into partly used tracks.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+int P2_Startup(void *arg)
+{
+    int rc, i, track, first;
+
+    P2ClockInit();
+    P2DiskInit();
+
+    // track 0 holds the allocator's bitmap, so the first whole track is track 1
+    rc = P2_DiskAlloc(0, USLOSS_DISK_TRACK_SIZE, &track, &first);
+    TEST(rc, P1_SUCCESS);
+    TEST(track, 1);
+    TEST(first, 0);
+
+    // small extents fill the rest of track 0
+    rc = P2_DiskAlloc(0, 3, &track, &first);
+    TEST(rc, P1_SUCCESS);
+    TEST(track, 0);
+    TEST(first, 1);
+    rc = P2_DiskAlloc(0, 3, &track, &first);
+    TEST(rc, P1_SUCCESS);
+    TEST(track, 0);
+    TEST(first, 4);
+
+    rc = P2_DiskAlloc(0, USLOSS_DISK_TRACK_SIZE + 4, &track, &first);
+    TEST(rc, P1_SUCCESS);
+    TEST(track, 2);
+    TEST(first, 0);
+
+    rc = P2_DiskFree(0, 0, 1, 3);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskAlloc(0, 2, &track, &first);
+    TEST(rc, P1_SUCCESS);
+    TEST(track, 0);
+    TEST(first, 1);
+    // sector 3 is free again, and the bitmap itself cannot be freed
+    TEST(P2_DiskFree(0, 0, 1, 3), P2_INVALID_SECTORS);
+    TEST(P2_DiskFree(0, 0, 0, 1), P2_INVALID_TRACK);
+
+    // tracks 4 to 9 are the only whole tracks left
+    for (i = 4; i < 10; i++) {
+        rc = P2_DiskAlloc(0, USLOSS_DISK_TRACK_SIZE, &track, &first);
+        TEST(rc, P1_SUCCESS);
+        TEST(track, i);
+    }
+    rc = P2_DiskAlloc(0, USLOSS_DISK_TRACK_SIZE, &track, &first);
+    TEST(rc, P2_NO_SPACE);
+    TEST(P2_DiskAlloc(0, 0, &track, &first), P2_INVALID_SECTORS);
+    TEST(P2_DiskAlloc(2, 1, &track, &first), P1_INVALID_UNIT);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * test_async.c
+ *
+ * Keeps both disk units busy from one process with asynchronous requests, then
+ * checks that it cannot hold more than P2_DISK_MAX_ASYNC of them on a unit.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_REQUESTS 4
+
+static int passed = FALSE;
+
+static char buffers[NUM_REQUESTS][USLOSS_DISK_SECTOR_SIZE];
+static char checks[NUM_REQUESTS][USLOSS_DISK_SECTOR_SIZE];
+static int held[P2_DISK_MAX_ASYNC];
+
+int P2_Startup(void *arg)
+{
+    int rc, i, done;
+    int handles[NUM_REQUESTS];
+
+    P2ClockInit();
+    P2DiskInit();
+
+    // two writes on each unit, all in flight at once
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        snprintf(buffers[i], sizeof(buffers[i]), "request %d", i);
+        rc = P2_DiskWriteAsync(i % 2, i, 0, 1, buffers[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (done = 0; done < NUM_REQUESTS; done++) {
+        i = P2_DiskWaitAny(handles, NUM_REQUESTS - done);
+        TEST(i >= 0, 1);
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+        // a collected handle is no longer valid
+        TEST(P2_DiskWait(handles[i]), P2_INVALID_HANDLE);
+        handles[i] = handles[NUM_REQUESTS - done - 1];
+    }
+
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        rc = P2_DiskReadAsync(i % 2, i, 0, 1, checks[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = NUM_REQUESTS - 1; i >= 0; i--) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+        TEST(strcmp(buffers[i], checks[i]), 0);
+    }
+
+    // past the cap the request fails instead of waiting for a slot only we can free
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        rc = P2_DiskWriteAsync(0, i % 10, 1, 1, buffers[0], &held[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(P2_DiskWriteAsync(0, 0, 1, 1, buffers[0], &handles[0]), P2_TOO_MANY_REQUESTS);
+    // synchronous requests and other units are not affected
+    rc = P2_DiskRead(0, 0, 0, 1, checks[0]);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskReadAsync(1, 0, 0, 1, checks[1], &handles[1]);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskWait(handles[1]);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        rc = P2_DiskWait(held[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_DiskReadAsync(0, 0, 1, 1, checks[0], &handles[0]);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskWait(handles[0]);
+    TEST(rc, P1_SUCCESS);
+
+    TEST(P2_DiskWait(-1), P2_INVALID_HANDLE);
+    TEST(P2_DiskWaitAny(NULL, 1), P2_NULL_ADDRESS);
+    TEST(P2_DiskReadAsync(0, 0, 0, 1, checks[0], NULL), P2_NULL_ADDRESS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,115 @@
+/*
+ * test_asyncShare.c
+ *
+ * Two processes each take as many asynchronous requests on unit 0 as they are allowed
+ * and leave them uncollected, then both make synchronous reads, which must still find
+ * a free request instead of waiting forever.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+static char buffer[USLOSS_DISK_SECTOR_SIZE];
+static char checks[2][USLOSS_DISK_SECTOR_SIZE];
+static int held[2][P2_DISK_MAX_ASYNC];
+static int ready, go;
+
+// takes requests until refused and returns how many it got
+static int Hold(int *handles) {
+    int rc, n;
+    for (n = 0; n < P2_DISK_MAX_ASYNC; n++) {
+        rc = P2_DiskWriteAsync(0, n % 10, 1, 1, buffer, &handles[n]);
+        if (rc != P1_SUCCESS) {
+            TEST(rc, P2_TOO_MANY_REQUESTS);
+            break;
+        }
+    }
+    return n;
+}
+
+// collects the requests Hold took
+static void Release(int *handles, int n) {
+    int rc, i;
+    for (i = 0; i < n; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+}
+
+static int Holder(void *arg) {
+    int rc, n;
+
+    n = Hold(held[1]);
+    TEST(n, P2_DISK_MAX_ASYNC);
+    rc = P1_V(ready);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_P(go);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(0, 0, 0, 1, checks[1]);
+    TEST(rc, P1_SUCCESS);
+    Release(held[1], n);
+    return 0;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, n, pid, status;
+
+    P2ClockInit();
+    P2DiskInit();
+    rc = P1_SemCreate("ready", 0, &ready);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_SemCreate("go", 0, &go);
+    TEST(rc, P1_SUCCESS);
+
+    rc = P1_Fork("Holder", Holder, NULL, USLOSS_MIN_STACK, 3, 0, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_P(ready);
+    TEST(rc, P1_SUCCESS);
+    // the unit-wide limit stops us before our own does
+    n = Hold(held[0]);
+    TEST(n, P2_DISK_MAX_ASYNC_UNIT - P2_DISK_MAX_ASYNC);
+    rc = P2_DiskRead(0, 0, 0, 1, checks[0]);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_V(go);
+    TEST(rc, P1_SUCCESS);
+    Release(held[0], n);
+    rc = P1_Join(0, &pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 0);
+
+    // with everything collected the limits are back to full
+    n = Hold(held[0]);
+    TEST(n, P2_DISK_MAX_ASYNC);
+    Release(held[0], n);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * test_bench_contention.c
+ *
+ * Several processes run random mixed workloads on the same unit at once, with unit 0
+ * under FIFO and unit 1 under C-LOOK, to compare the schedulers under contention.
+ * Both disks have 100 tracks. See bench.h for the output format.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+#include "bench.h"
+
+#define NUM_WORKERS 4
+#define NUM_OPS 32
+#define SECTORS 2
+
+static int passed = FALSE;
+
+static char buffers[NUM_WORKERS][BENCH_MAX_SECTORS * USLOSS_DISK_SECTOR_SIZE];
+
+int Worker(void *arg) {
+    int id = (int) arg;
+    return BenchLoad(id / NUM_WORKERS, BENCH_MIXED, FALSE, NUM_OPS, SECTORS, 0,
+                     buffers[id % NUM_WORKERS]);
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, unit, i, pid, status;
+    BenchRun run;
+
+    rc = P2DiskSetScheduler(1, P2_DISK_CLOOK);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+    for (unit = 0; unit < 2; unit++) {
+        BenchBegin(unit, &run);
+        for (i = 0; i < NUM_WORKERS; i++) {
+            rc = P1_Fork(MakeName("Worker", i), Worker, (void *) (unit * NUM_WORKERS + i),
+                         USLOSS_MIN_STACK, 3, 0, &pid);
+            TEST(rc, P1_SUCCESS);
+        }
+        for (i = 0; i < NUM_WORKERS; i++) {
+            rc = P1_Join(0, &pid, &status);
+            TEST(rc, P1_SUCCESS);
+            TEST(status, P1_SUCCESS);
+        }
+        BenchEnd(&run, unit == 0 ? "contention-fifo" : "contention-clook",
+                 NUM_WORKERS * NUM_OPS, NUM_WORKERS * NUM_OPS * SECTORS);
+    }
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 100);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 100);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * test_bench_multitrack.c
+ *
+ * Sequential write and read throughput with requests spanning several tracks, with the
+ * cache off so every sector goes to the device. This measures how closely the driver
+ * packs the device operations of one request. See bench.h for the output format.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+#include "bench.h"
+
+#define NUM_OPS 16
+
+static int passed = FALSE;
+
+int P2_Startup(void *arg)
+{
+    int rc, unit;
+
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+    for (unit = 0; unit < 2; unit++) {
+        rc = BenchMeasure("seq-write-2track", unit, BENCH_WRITE, TRUE, NUM_OPS,
+                          2 * USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-write-4track", unit, BENCH_WRITE, TRUE, NUM_OPS,
+                          4 * USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-read-2track", unit, BENCH_READ, TRUE, NUM_OPS,
+                          2 * USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-read-4track", unit, BENCH_READ, TRUE, NUM_OPS,
+                          4 * USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+    }
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 100);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
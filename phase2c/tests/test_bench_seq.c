@@ -0,0 +1,63 @@
+/*
+ * test_bench_seq.c
+ *
+ * Sequential write and read throughput with single-sector and whole-track requests,
+ * on a 10-track and a 100-track disk. See bench.h for the output format.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+#include "bench.h"
+
+#define NUM_OPS 64
+
+static int passed = FALSE;
+
+int P2_Startup(void *arg)
+{
+    int rc, unit;
+
+    P2ClockInit();
+    P2DiskInit();
+    for (unit = 0; unit < 2; unit++) {
+        rc = BenchMeasure("seq-write-1", unit, BENCH_WRITE, TRUE, NUM_OPS, 1);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-write-track", unit, BENCH_WRITE, TRUE, NUM_OPS,
+                          USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-read-1", unit, BENCH_READ, TRUE, NUM_OPS, 1);
+        TEST(rc, P1_SUCCESS);
+        rc = BenchMeasure("seq-read-track", unit, BENCH_READ, TRUE, NUM_OPS,
+                          USLOSS_DISK_TRACK_SIZE);
+        TEST(rc, P1_SUCCESS);
+    }
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 100);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
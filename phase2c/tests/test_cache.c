@@ -0,0 +1,92 @@
+/*
+ * test_cache.c
+ *
+ * Re-reads the same sectors and checks that the buffer cache serves them, then
+ * overwrites them and checks that the cache returns the new contents.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_READS 10
+
+static int passed = FALSE;
+
+int P3_Startup(void *arg) {
+    char buffer[2*USLOSS_DISK_SECTOR_SIZE];
+    char check[2*USLOSS_DISK_SECTOR_SIZE];
+    int rc;
+
+    // the last sector of track 0 and the first of track 1
+    memset(buffer, 'a', sizeof(buffer));
+    rc = Sys_DiskWrite(buffer, 0, USLOSS_DISK_TRACK_SIZE - 1, 2, 0);
+    TEST(rc, P1_SUCCESS);
+    for (int i = 0; i < NUM_READS; i++) {
+        bzero(check, sizeof(check));
+        rc = Sys_DiskRead(check, 0, USLOSS_DISK_TRACK_SIZE - 1, 2, 0);
+        TEST(rc, P1_SUCCESS);
+        TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+    }
+
+    memset(buffer, 'b', sizeof(buffer));
+    rc = Sys_DiskWrite(buffer, 0, USLOSS_DISK_TRACK_SIZE - 1, 2, 0);
+    TEST(rc, P1_SUCCESS);
+    bzero(check, sizeof(check));
+    rc = Sys_DiskRead(check, 0, USLOSS_DISK_TRACK_SIZE - 1, 2, 0);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+    int hits, misses, evictions;
+
+    rc = P2DiskSetCacheSize(P2_DISK_CACHE_MAX + 1);
+    TEST(rc, P2_INVALID_SECTORS);
+    rc = P2DiskSetCacheSize(8);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+
+    rc = P2_DiskCacheStats(&hits, &misses, &evictions);
+    TEST(rc, P1_SUCCESS);
+    // every read was served from the sectors the writes left in the cache
+    TEST(hits, 2 * (NUM_READS + 1));
+    TEST(misses, 0);
+    TEST(evictions, 0);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
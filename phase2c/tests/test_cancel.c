@@ -0,0 +1,129 @@
+/*
+ * test_cancel.c
+ *
+ * Cancels a queued asynchronous request and lets a request run out of time. Then a
+ * process quits with requests still queued, and neither its requests nor its share of
+ * the asynchronous limit are left to whoever uses its pid next.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_REQUESTS 4
+
+static int passed = FALSE;
+
+static char buffers[NUM_REQUESTS][USLOSS_DISK_TRACK_SIZE*USLOSS_DISK_SECTOR_SIZE];
+static int orphans[P2_DISK_MAX_ASYNC];
+
+// queues whole-track writes on unit 1 and quits without collecting them
+static int Quitter(void *arg) {
+    int rc, i;
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        rc = P2_DiskWriteAsync(1, i % 10, 0, USLOSS_DISK_TRACK_SIZE, buffers[0], &orphans[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 0;
+}
+
+// takes as many asynchronous requests on unit 1 as it may, then collects them
+static int Successor(void *arg) {
+    int rc, i;
+    int handles[P2_DISK_MAX_ASYNC];
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        TEST(P2_DiskWait(orphans[i]), P2_INVALID_HANDLE);
+        TEST(P2_DiskCancel(orphans[i]), P2_INVALID_HANDLE);
+    }
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        rc = P2_DiskReadAsync(1, i % 10, 0, 1, buffers[1], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < P2_DISK_MAX_ASYNC; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 0;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, pid, status;
+    int handles[NUM_REQUESTS];
+
+    P2ClockInit();
+    P2DiskInit();
+
+    // whole-track writes far apart, so the last one is still queued when it is cancelled
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        memset(buffers[i], 'A' + i, sizeof(buffers[i]));
+        rc = P2_DiskWriteAsync(0, i * 3, 0, USLOSS_DISK_TRACK_SIZE, buffers[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_DiskCancel(handles[NUM_REQUESTS - 1]);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < NUM_REQUESTS - 1; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_DiskWait(handles[NUM_REQUESTS - 1]);
+    TEST(rc, P2_CANCELLED);
+    // a collected handle can no longer be cancelled
+    TEST(P2_DiskCancel(handles[0]), P2_INVALID_HANDLE);
+    TEST(P2_DiskCancel(-1), P2_INVALID_HANDLE);
+
+    // a track's worth of sectors takes far longer than a microsecond
+    rc = P2_DiskSetTimeout(1);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskWrite(1, 5, 0, USLOSS_DISK_TRACK_SIZE, buffers[0]);
+    TEST(rc, P2_TIMED_OUT);
+    rc = P2_DiskSetTimeout(0);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskWrite(1, 5, 0, USLOSS_DISK_TRACK_SIZE, buffers[0]);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2_DiskSetTimeout(-1), P2_INVALID_SECONDS);
+
+    // the driver drops what the quitter left queued and frees its requests, so the
+    // next process, which may get the same pid, starts with none
+    rc = P1_Fork("Quitter", Quitter, NULL, USLOSS_MIN_STACK, 3, 0, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Join(0, &pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 0);
+    rc = P2_DiskWrite(1, 0, 0, 1, buffers[1]);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Fork("Successor", Successor, NULL, USLOSS_MIN_STACK, 3, 0, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Join(0, &pid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(status, 0);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
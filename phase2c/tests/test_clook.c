@@ -0,0 +1,147 @@
+/*
+ * test_clook.c
+ *
+ * Queues the same scattered writes on unit 0, which uses the C-LOOK scheduler, and on
+ * unit 1, which uses FIFO, and checks that C-LOOK serves them in one sweep with less
+ * head travel. Then several processes write and read back sectors on scattered tracks
+ * of unit 0.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_WORKERS 8
+#define NUM_TRACKS 20
+#define NUM_QUEUED 7
+
+static int passed = FALSE;
+
+static int queued[NUM_QUEUED] = {10, 2, 17, 5, 14, 0, 8};
+static char buffer[USLOSS_DISK_SECTOR_SIZE];
+static P2_DiskTraceEntry entries[2 * NUM_QUEUED];
+
+// queues a write to each track in queued on a unit, waits for them, and returns how
+// many times the head went back towards track 0 from one request to the next
+static int
+Descents(int unit)
+{
+    int rc, i, count, last = -1, descents = 0;
+    int handles[NUM_QUEUED];
+
+    for (i = 0; i < NUM_QUEUED; i++) {
+        rc = P2_DiskWriteAsync(unit, queued[i], 0, 1, buffer, &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < NUM_QUEUED; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    // the trace is in completion order
+    rc = P2_DiskTraceRead(entries, 2 * NUM_QUEUED, &count);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < count; i++) {
+        if (entries[i].unit != unit) continue;
+        if (entries[i].track < last) descents++;
+        last = entries[i].track;
+    }
+    return descents;
+}
+
+int Worker(void *arg) {
+    int track = (int) arg;
+    char buffer[USLOSS_DISK_SECTOR_SIZE];
+    char check[USLOSS_DISK_SECTOR_SIZE];
+
+    bzero(buffer, sizeof(buffer));
+    snprintf(buffer, sizeof(buffer), "track %d", track);
+    int rc = Sys_DiskWrite(buffer, track, 3, 1, 0);
+    TEST(rc, P1_SUCCESS);
+
+    bzero(check, sizeof(check));
+    rc = Sys_DiskRead(check, track, 3, 1, 0);
+    TEST(rc, P1_SUCCESS);
+    TEST(strcmp(buffer, check), 0);
+    return 0;
+}
+
+int P3_Startup(void *arg) {
+    int rc, pid, status;
+
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        // spread the workers over the disk out of order
+        int track = (i * 7) % NUM_TRACKS;
+        rc = Sys_Spawn(MakeName("Worker", i), Worker, (void *) track, USLOSS_MIN_STACK, 4, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        rc = Sys_Wait(&pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status, 0);
+    }
+    return 11;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, waitPid, status, p3Pid;
+    int clookSeeks, fifoSeeks, elided, clookTraveled, fifoTraveled;
+
+    rc = P2DiskSetScheduler(0, P2_DISK_CLOOK);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskSetScheduler(0, 42);
+    TEST(rc, P2_INVALID_POLICY);
+    rc = P2DiskSetScheduler(1, P2_DISK_FIFO);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskSetTrace(2 * NUM_QUEUED);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+    rc = P2DiskSetScheduler(0, P2_DISK_FIFO);
+    TEST(rc, P1_INVALID_STATE);
+
+    // the first write may be served before the rest are queued, after that C-LOOK
+    // sweeps up from it and wraps around once; FIFO goes back and forth
+    TEST(Descents(0) <= 1, 1);
+    TEST(Descents(1) > 1, 1);
+    rc = P2_DiskSeekStats(0, &clookSeeks, &elided, &clookTraveled);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskSeekStats(1, &fifoSeeks, &elided, &fifoTraveled);
+    TEST(rc, P1_SUCCESS);
+    TEST(clookTraveled < fifoTraveled, 1);
+
+    rc = P2_Spawn("P3_Startup", P3_Startup, NULL, 4*USLOSS_MIN_STACK, 3, &p3Pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_Wait(&waitPid, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(waitPid, p3Pid);
+    TEST(status, 11);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, NUM_TRACKS);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, NUM_TRACKS);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
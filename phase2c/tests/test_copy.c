@@ -0,0 +1,95 @@
+/*
+ * test_copy.c
+ *
+ * Fills a range with a pattern, copies ranges several chunks long between units and
+ * within a unit, including overlapping ones, and checks the results.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define SECTOR USLOSS_DISK_SECTOR_SIZE
+#define NUM_SECTORS (2*USLOSS_DISK_TRACK_SIZE + 5)
+#define SHIFT 5
+
+static int passed = FALSE;
+
+static char data[(NUM_SECTORS + SHIFT) * SECTOR];
+static char check[(NUM_SECTORS + SHIFT) * SECTOR];
+
+int P2_Startup(void *arg)
+{
+    int rc, i;
+    char pattern[SECTOR];
+
+    P2ClockInit();
+    P2DiskInit();
+
+    memset(pattern, 'p', sizeof(pattern));
+    rc = P2_DiskFill(0, 6, 3, NUM_SECTORS, pattern);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(0, 6, 3, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < NUM_SECTORS; i++) {
+        TEST(memcmp(check + i * SECTOR, pattern, SECTOR), 0);
+    }
+
+    for (i = 0; i < NUM_SECTORS; i++) {
+        memset(data + i * SECTOR, 'A' + i % 26, SECTOR);
+    }
+    rc = P2_DiskWrite(0, 1, 2, NUM_SECTORS, data);
+    TEST(rc, P1_SUCCESS);
+
+    // between units, to a different offset within the track
+    rc = P2_DiskCopy(0, 1, 2, 1, 3, 7, NUM_SECTORS);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(1, 3, 7, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(data, check, NUM_SECTORS * SECTOR), 0);
+
+    // overlapping, toward higher and then back toward lower sectors
+    rc = P2_DiskCopy(0, 1, 2, 0, 1, 2 + SHIFT, NUM_SECTORS);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(0, 1, 2 + SHIFT, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(data, check, NUM_SECTORS * SECTOR), 0);
+    rc = P2_DiskCopy(0, 1, 2 + SHIFT, 0, 1, 2, NUM_SECTORS);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(0, 1, 2, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(data, check, NUM_SECTORS * SECTOR), 0);
+
+    TEST(P2_DiskCopy(0, 9, 0, 1, 0, 0, 2 * USLOSS_DISK_TRACK_SIZE), P2_INVALID_SECTORS);
+    TEST(P2_DiskCopy(0, 0, 0, 2, 0, 0, 1), P1_INVALID_UNIT);
+    TEST(P2_DiskFill(0, 0, 0, 1, NULL), P2_NULL_ADDRESS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,80 @@
+/*
+ * test_deadline.c
+ *
+ * Runs a write and reads under the deadline policy with a zero read deadline, so
+ * every read is served through the deadline path and the write never is.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_REQUESTS 3
+
+static int passed = FALSE;
+
+static char buffers[NUM_REQUESTS][USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, i;
+    int handles[NUM_REQUESTS];
+    int tracks[NUM_REQUESTS] = {9, 1, 5};
+    P2_DiskStatistics info;
+
+    // make the reads go to the disk
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskSetScheduler(0, P2_DISK_DEADLINE);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskSetDeadlines(0, 0, 10000000);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2DiskSetDeadlines(0, -1, 0), P2_INVALID_POLICY);
+    P2ClockInit();
+    P2DiskInit();
+    TEST(P2DiskSetDeadlines(0, 0, 0), P1_INVALID_STATE);
+
+    rc = P2_DiskWriteAsync(0, tracks[0], 0, 1, buffers[0], &handles[0]);
+    TEST(rc, P1_SUCCESS);
+    for (i = 1; i < NUM_REQUESTS; i++) {
+        rc = P2_DiskReadAsync(0, tracks[i], 0, 1, buffers[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+
+    rc = P2_DiskStats(0, &info);
+    TEST(rc, P1_SUCCESS);
+    TEST(info.reads, NUM_REQUESTS - 1);
+    TEST(info.expiredReads, NUM_REQUESTS - 1);
+    TEST(info.expiredWrites, 0);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * test_fair.c
+ *
+ * A bulk process queues several whole-track writes, then a foreground process reads
+ * one sector. Under the fair policy the read gets its turn before the bulk writes
+ * are all done.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_WRITES 6
+
+static int passed = FALSE;
+
+static char bulk[NUM_WRITES][USLOSS_DISK_TRACK_SIZE*USLOSS_DISK_SECTOR_SIZE];
+
+int Bulk(void *arg) {
+    int rc, i;
+    int handles[NUM_WRITES];
+
+    for (i = 0; i < NUM_WRITES; i++) {
+        // every other track, so the driver cannot merge them
+        rc = P2_DiskWriteAsync(0, 2 * i, 0, USLOSS_DISK_TRACK_SIZE, bulk[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < NUM_WRITES; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    return 0;
+}
+
+int Foreground(void *arg) {
+    int rc;
+    char buffer[USLOSS_DISK_SECTOR_SIZE];
+    P2_DiskStatistics info;
+
+    rc = P2_DiskRead(0, 15, 0, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskStats(0, &info);
+    TEST(rc, P1_SUCCESS);
+    TEST(info.writes < NUM_WRITES, 1);
+    return 0;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, pid, status;
+
+    rc = P2DiskSetScheduler(0, P2_DISK_FAIR);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    rc = P2_DiskSetWeight(P1_GetPid(), P2_DISK_MAX_WEIGHT + 1);
+    TEST(rc, P2_INVALID_WEIGHT);
+    rc = P2_DiskSetWeight(-1, 1);
+    TEST(rc, P1_INVALID_PID);
+
+    // the bulk process runs first and queues all its writes before it blocks
+    rc = P1_Fork("Bulk", Bulk, NULL, USLOSS_MIN_STACK, 3, 0, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P1_Fork("Foreground", Foreground, NULL, USLOSS_MIN_STACK, 4, 0, &pid);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskSetWeight(pid, 2);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < 2; i++) {
+        rc = P1_Join(0, &pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status, 0);
+    }
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 16);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * test_flush.c
+ *
+ * Queues writes on unit 0, which uses the C-LOOK scheduler, where the sweep would
+ * reach the flush on track 0 first, and checks that the flush still waits for all of
+ * them.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_WRITES 3
+
+static int passed = FALSE;
+
+static char busy[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+static char buffers[NUM_WRITES][USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, i;
+    int handles[NUM_WRITES + 1];
+    P2_DiskStatistics info;
+
+    rc = P2DiskSetScheduler(0, P2_DISK_CLOOK);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    // leaves the head on the last track, so C-LOOK wraps around to track 0 next
+    rc = P2_DiskWriteAsync(0, 9, 0, USLOSS_DISK_TRACK_SIZE, busy, &handles[NUM_WRITES]);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < NUM_WRITES; i++) {
+        snprintf(buffers[i], sizeof(buffers[i]), "write %d", i);
+        rc = P2_DiskWriteAsync(0, 3 + i, 0, 1, buffers[i], &handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    rc = P2_DiskFlush(0);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskStats(0, &info);
+    TEST(rc, P1_SUCCESS);
+    TEST(info.writes, NUM_WRITES + 1);
+    TEST(info.flushes, 1);
+    for (i = 0; i <= NUM_WRITES; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * test_merge.c
+ *
+ * Queues a read of sector 4, a write of sector 5 and a read of sector 5 behind a long
+ * write on another track, and checks that the second read is not merged ahead of the
+ * write it was submitted after.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_REQUESTS 4
+
+static int passed = FALSE;
+
+static char busy[USLOSS_DISK_TRACK_SIZE][USLOSS_DISK_SECTOR_SIZE];
+static char first[USLOSS_DISK_SECTOR_SIZE];
+static char written[USLOSS_DISK_SECTOR_SIZE];
+static char second[USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, i;
+    int handles[NUM_REQUESTS];
+
+    // without the cache every read goes to the disk
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    rc = P2DiskSetScheduler(0, P2_DISK_FIFO);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    // keeps the driver busy while the rest queue up behind it
+    rc = P2_DiskWriteAsync(0, 9, 0, USLOSS_DISK_TRACK_SIZE, busy, &handles[0]);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskReadAsync(0, 0, 4, 1, first, &handles[1]);
+    TEST(rc, P1_SUCCESS);
+    strcpy(written, "written");
+    rc = P2_DiskWriteAsync(0, 0, 5, 1, written, &handles[2]);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskReadAsync(0, 0, 5, 1, second, &handles[3]);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < NUM_REQUESTS; i++) {
+        rc = P2_DiskWait(handles[i]);
+        TEST(rc, P1_SUCCESS);
+    }
+    TEST(strcmp(second, written), 0);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * test_mirror.c
+ *
+ * Writes to the mirrored virtual disk, checks that both units got the data, and
+ * checks that reads go to the unit whose head is closer.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_SECTORS 3
+
+static int passed = FALSE;
+
+static char buffer[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+static char check[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, unit, tracks, primary, secondary;
+
+    // make the reads go to the disk
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2DiskSetMirror(0, 0), P1_INVALID_UNIT);
+    P2ClockInit();
+    P2DiskInit();
+
+    rc = P2_MirrorStats(&tracks, &primary, &secondary);
+    TEST(rc, P1_SUCCESS);
+    TEST(tracks, 8);
+
+    memset(buffer, 'm', sizeof(buffer));
+    rc = P2_MirrorWrite(2, USLOSS_DISK_TRACK_SIZE - 1, NUM_SECTORS, buffer);
+    TEST(rc, P1_SUCCESS);
+    for (unit = 0; unit < 2; unit++) {
+        bzero(check, sizeof(check));
+        rc = P2_DiskRead(unit, 2, USLOSS_DISK_TRACK_SIZE - 1, NUM_SECTORS, check);
+        TEST(rc, P1_SUCCESS);
+        TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+    }
+
+    // both heads are on track 3, move unit 1's next to track 7
+    rc = P2_DiskRead(1, 7, 0, 1, check);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_MirrorRead(7, 0, 1, check);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_MirrorRead(2, USLOSS_DISK_TRACK_SIZE - 1, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+    rc = P2_MirrorStats(&tracks, &primary, &secondary);
+    TEST(rc, P1_SUCCESS);
+    TEST(primary, 1);
+    TEST(secondary, 1);
+
+    // the mirror is only as large as the smaller unit
+    TEST(P2_MirrorRead(8, 0, 1, check), P2_INVALID_TRACK);
+    TEST(P2_MirrorWrite(7, USLOSS_DISK_TRACK_SIZE - 1, 2, buffer), P2_INVALID_SECTORS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 8);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * test_pread.c
+ *
+ * Reads and writes unaligned byte ranges, including ones that cross sector and track
+ * boundaries, and checks them against a copy of the disk kept in memory.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define SECTOR USLOSS_DISK_SECTOR_SIZE
+#define NUM_SECTORS 4
+// byte offset of the last sector of track 0, the range runs onto track 1
+#define BASE ((USLOSS_DISK_TRACK_SIZE - 1) * SECTOR)
+
+static int passed = FALSE;
+
+static char model[NUM_SECTORS * SECTOR];
+static char check[NUM_SECTORS * SECTOR];
+
+// writes len bytes of c at an offset from BASE, both to the disk and the model
+static void
+Update(int offset, int len, char c)
+{
+    static char data[NUM_SECTORS * SECTOR];
+    memset(data, c, len);
+    memset(model + offset, c, len);
+    int rc = P2_DiskPwrite(0, BASE + offset, len, data);
+    TEST(rc, P1_SUCCESS);
+}
+
+// reads len bytes at an offset from BASE and compares them with the model
+static void
+Check(int offset, int len)
+{
+    bzero(check, sizeof(check));
+    int rc = P2_DiskPread(0, BASE + offset, len, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(model + offset, check, len), 0);
+}
+
+int P2_Startup(void *arg)
+{
+    int rc;
+
+    P2ClockInit();
+    P2DiskInit();
+
+    memset(model, 'a', sizeof(model));
+    rc = P2_DiskWrite(0, 0, USLOSS_DISK_TRACK_SIZE - 1, NUM_SECTORS, model);
+    TEST(rc, P1_SUCCESS);
+
+    Update(10, 20, 'b');                        // inside one sector
+    Update(SECTOR - 5, 10, 'c');                // across the track boundary
+    Update(SECTOR + 100, 2 * SECTOR, 'd');      // partial, whole and partial sectors
+    Update(SECTOR, SECTOR, 'e');                // exactly one sector
+
+    Check(0, sizeof(model));
+    Check(7, 3);
+    Check(SECTOR - 1, 2);
+    Check(SECTOR + 99, 2 * SECTOR + 2);
+    Check(2 * SECTOR, SECTOR);
+
+    TEST(P2_DiskPread(0, 0, 0, check), P1_SUCCESS);
+    TEST(P2_DiskPread(0, -1, 1, check), P2_INVALID_FIRST);
+    TEST(P2_DiskPread(0, 10 * USLOSS_DISK_TRACK_SIZE * SECTOR - 1, 2, check), P2_INVALID_SECTORS);
+    TEST(P2_DiskPwrite(0, 0, 1, NULL), P2_NULL_ADDRESS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
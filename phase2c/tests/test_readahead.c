@@ -0,0 +1,109 @@
+/*
+ * test_readahead.c
+ *
+ * Reads a unit sequentially with the cache on and checks that the driver prefetches a
+ * growing window while it is idle, that the prefetched sectors are counted as hits
+ * when read, and that a read elsewhere ends the stream.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define START 20    // first sector read, away from where a stream starts out
+
+static int passed = FALSE;
+
+static char buffer[2*P2_READAHEAD_MIN*USLOSS_DISK_SECTOR_SIZE];
+
+// reads sectors from a unit-relative sector of unit 0
+static int
+Read(int sector, int sectors)
+{
+    return P2_DiskRead(0, sector / USLOSS_DISK_TRACK_SIZE, sector % USLOSS_DISK_TRACK_SIZE,
+                       sectors, buffer);
+}
+
+// gives the idle driver time to prefetch, then checks the counters
+static void
+Check(int issued, int hits, int wasted)
+{
+    int rc, i, h, w;
+
+    rc = P2_Sleep(1);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskPrefetchStats(&i, &h, &w);
+    TEST(rc, P1_SUCCESS);
+    TEST(i, issued);
+    TEST(h, hits);
+    TEST(w, wasted);
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, status;
+    P2_DiskSegment segment;
+
+    rc = P2DiskSetCacheSize(P2_DISK_CACHE_DEFAULT);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    // a lone read is not a stream
+    rc = Read(START, 1);
+    TEST(rc, P1_SUCCESS);
+    Check(0, 0, 0);
+
+    // the next sector starts one, with the smallest window
+    rc = Read(START + 1, 1);
+    TEST(rc, P1_SUCCESS);
+    Check(P2_READAHEAD_MIN, 0, 0);
+
+    // reading the window from the cache doubles it
+    rc = Read(START + 2, P2_READAHEAD_MIN);
+    TEST(rc, P1_SUCCESS);
+    Check(3 * P2_READAHEAD_MIN, P2_READAHEAD_MIN, 0);
+
+    // a read elsewhere resets the window, so nothing more is prefetched
+    rc = Read(100, 1);
+    TEST(rc, P1_SUCCESS);
+    Check(3 * P2_READAHEAD_MIN, P2_READAHEAD_MIN, 0);
+
+    // the second window is transferred again by a vectored read, which always goes
+    // through the driver, before anyone read it from the cache
+    segment.track = (START + 2 + P2_READAHEAD_MIN) / USLOSS_DISK_TRACK_SIZE;
+    segment.first = (START + 2 + P2_READAHEAD_MIN) % USLOSS_DISK_TRACK_SIZE;
+    segment.sectors = 2 * P2_READAHEAD_MIN;
+    segment.buffer = buffer;
+    rc = P2_DiskReadV(0, &segment, 1, &status);
+    TEST(rc, P1_SUCCESS);
+    Check(3 * P2_READAHEAD_MIN, P2_READAHEAD_MIN, 2 * P2_READAHEAD_MIN);
+
+    TEST(P2_DiskPrefetchStats(NULL, &rc, &rc), P2_NULL_ADDRESS);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,224 @@
+/*
+ * test_replay.c
+ *
+ * Replays a disk request trace through P2_DiskRead and P2_DiskWrite. Each pid in the
+ * trace gets its own process, which issues that pid's requests in order and at the
+ * same offsets from the start of the trace as the original ones, so the replay has
+ * the original timing and concurrency.
+ *
+ * If DISK_TRACE names a file of TRACE lines, as printed by P2_DiskTraceDump, that
+ * trace is replayed and the disks are made large enough for it. Otherwise a trace is
+ * first recorded from a small two-process workload and dumped. Either way the replay
+ * is traced as well and prints a BENCH line per unit, see bench.h.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+#include "bench.h"
+
+#define MAX_ENTRIES     1024
+#define MAX_REPLAYERS   16
+#define MIN_TRACKS      100
+#define NUM_WORKERS     2
+#define NUM_OPS         32
+
+static int passed = FALSE;
+
+static P2_DiskTraceEntry entries[MAX_ENTRIES];
+static int numEntries = 0;
+static int loaded = FALSE;
+
+static int pids[MAX_REPLAYERS];
+static int numReplayers = 0;
+static int replayStart, traceStart;
+static char buffers[MAX_REPLAYERS][BENCH_MAX_SECTORS * USLOSS_DISK_SECTOR_SIZE];
+static char workerBuffers[NUM_WORKERS][BENCH_MAX_SECTORS * USLOSS_DISK_SECTOR_SIZE];
+
+int Worker(void *arg) {
+    int id = (int) arg;
+    return BenchLoad(0, BENCH_MIXED, id == 0, NUM_OPS, 1 + id, 0, workerBuffers[id]);
+}
+
+// waits until the clock reaches a time, sleeping through whole seconds and spinning
+// through the rest
+static void
+WaitUntil(int time)
+{
+    while (BenchNow() < time) {
+        if (time - BenchNow() >= 1000000) {
+            int rc = P2_Sleep(1);
+            assert(rc == P1_SUCCESS);
+        }
+    }
+}
+
+int Replayer(void *arg) {
+    int slot = (int) arg;
+    int i, done, rc, failures = 0;
+
+    for (i = 0; i < numEntries; i++) {
+        P2_DiskTraceEntry *entry = &entries[i];
+        if (entry->pid != pids[slot]) {
+            continue;
+        }
+        WaitUntil(replayStart + entry->time - traceStart);
+        // requests larger than the buffer are replayed a buffer at a time
+        for (done = 0; done < entry->sectors; done += BENCH_MAX_SECTORS) {
+            int sector = entry->track * USLOSS_DISK_TRACK_SIZE + entry->first + done;
+            int sectors = entry->sectors - done;
+            if (sectors > BENCH_MAX_SECTORS) {
+                sectors = BENCH_MAX_SECTORS;
+            }
+            if (entry->type == USLOSS_DISK_READ) {
+                rc = P2_DiskRead(entry->unit, sector / USLOSS_DISK_TRACK_SIZE,
+                                 sector % USLOSS_DISK_TRACK_SIZE, sectors, buffers[slot]);
+            } else {
+                rc = P2_DiskWrite(entry->unit, sector / USLOSS_DISK_TRACK_SIZE,
+                                  sector % USLOSS_DISK_TRACK_SIZE, sectors, buffers[slot]);
+            }
+            if (rc != P1_SUCCESS) {
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+// orders trace entries by submission time, the trace itself is in completion order
+static int
+CompareEntries(const void *a, const void *b)
+{
+    return ((P2_DiskTraceEntry *) a)->time - ((P2_DiskTraceEntry *) b)->time;
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, j, unit, pid, status, count;
+    int ops[USLOSS_DISK_UNITS] = {0}, sectors[USLOSS_DISK_UNITS] = {0};
+    BenchRun runs[USLOSS_DISK_UNITS];
+
+    rc = P2DiskSetTrace(P2_DISK_TRACE_MAX + 1);
+    TEST(rc, P2_INVALID_SECTORS);
+    rc = P2DiskSetTrace(MAX_ENTRIES);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    if (!loaded) {
+        for (i = 0; i < NUM_WORKERS; i++) {
+            rc = P1_Fork(MakeName("Worker", i), Worker, (void *) i, USLOSS_MIN_STACK, 3, 0, &pid);
+            TEST(rc, P1_SUCCESS);
+        }
+        for (i = 0; i < NUM_WORKERS; i++) {
+            rc = P1_Join(0, &pid, &status);
+            TEST(rc, P1_SUCCESS);
+            TEST(status, P1_SUCCESS);
+        }
+        rc = P2_DiskTraceRead(entries, MAX_ENTRIES, &numEntries);
+        TEST(rc, P1_SUCCESS);
+        TEST(numEntries, NUM_WORKERS * NUM_OPS);
+        P2_DiskTraceDump();
+    }
+
+    qsort(entries, numEntries, sizeof(entries[0]), CompareEntries);
+    traceStart = numEntries > 0 ? entries[0].time : 0;
+    for (i = 0; i < numEntries; i++) {
+        for (j = 0; j < numReplayers && pids[j] != entries[i].pid; j++) {
+        }
+        if (j == numReplayers) {
+            TEST(numReplayers < MAX_REPLAYERS, 1);
+            pids[numReplayers++] = entries[i].pid;
+        }
+        ops[entries[i].unit]++;
+        sectors[entries[i].unit] += entries[i].sectors;
+    }
+
+    for (unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        BenchBegin(unit, &runs[unit]);
+    }
+    replayStart = BenchNow();
+    for (i = 0; i < numReplayers; i++) {
+        rc = P1_Fork(MakeName("Replayer", i), Replayer, (void *) i, USLOSS_MIN_STACK, 3, 0, &pid);
+        TEST(rc, P1_SUCCESS);
+    }
+    for (i = 0; i < numReplayers; i++) {
+        rc = P1_Join(0, &pid, &status);
+        TEST(rc, P1_SUCCESS);
+        TEST(status, 0);
+    }
+    for (unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        if (ops[unit] > 0) {
+            BenchEnd(&runs[unit], "replay", ops[unit], sectors[unit]);
+        }
+    }
+
+    // the replay itself was traced too
+    rc = P2_DiskTraceRead(entries, MAX_ENTRIES, &count);
+    TEST(rc, P1_SUCCESS);
+    TEST(count >= numEntries || count == MAX_ENTRIES, 1);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+// reads the trace named by DISK_TRACE, if any, and returns the tracks each unit needs
+static void
+LoadTrace(int *tracks)
+{
+    char line[256], type[8];
+    char *path = getenv("DISK_TRACE");
+    FILE *file;
+
+    if (path == NULL || (file = fopen(path, "r")) == NULL) {
+        return;
+    }
+    while (numEntries < MAX_ENTRIES && fgets(line, sizeof(line), file) != NULL) {
+        P2_DiskTraceEntry *entry = &entries[numEntries];
+        int n = sscanf(line, "TRACE time=%d pid=%d unit=%d type=%7s track=%d first=%d sectors=%d "
+                       "latency=%d", &entry->time, &entry->pid, &entry->unit, type, &entry->track,
+                       &entry->first, &entry->sectors, &entry->latency);
+        if (n != 8 || entry->unit < 0 || entry->unit >= USLOSS_DISK_UNITS) {
+            continue;
+        }
+        entry->type = strcmp(type, "read") == 0 ? USLOSS_DISK_READ : USLOSS_DISK_WRITE;
+        int last = entry->track + (entry->first + entry->sectors - 1) / USLOSS_DISK_TRACK_SIZE;
+        if (last >= tracks[entry->unit]) {
+            tracks[entry->unit] = last + 1;
+        }
+        numEntries++;
+    }
+    fclose(file);
+    loaded = TRUE;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc, unit;
+    int tracks[USLOSS_DISK_UNITS];
+
+    for (unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        tracks[unit] = MIN_TRACKS;
+    }
+    LoadTrace(tracks);
+    for (unit = 0; unit < USLOSS_DISK_UNITS; unit++) {
+        rc = Disk_Create(NULL, unit, tracks[unit]);
+        assert(rc == 0);
+    }
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
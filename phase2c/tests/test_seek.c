@@ -0,0 +1,92 @@
+/*
+ * test_seek.c
+ *
+ * Runs requests that start on the track the head is already on, and one that crosses
+ * into the next track, and checks the seek counters.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+static int passed = FALSE;
+
+static char buffer[4*USLOSS_DISK_SECTOR_SIZE];
+
+// checks the seek counters of unit 0
+static void
+Check(int issued, int elided, int traveled)
+{
+    int rc, i, e, t;
+
+    rc = P2_DiskSeekStats(0, &i, &e, &t);
+    TEST(rc, P1_SUCCESS);
+    TEST(i, issued);
+    TEST(e, elided);
+    TEST(t, traveled);
+}
+
+int P2_Startup(void *arg)
+{
+    int rc, i, e, t;
+
+    // no read-ahead moving the head behind the test's back
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+    Check(0, 0, 0);
+
+    // the first seek is always issued, and counts the tracks from track 0
+    rc = P2_DiskWrite(0, 2, 0, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+    Check(1, 0, 2);
+
+    // the next sector on the same track needs no seek
+    rc = P2_DiskWrite(0, 2, 1, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+    Check(1, 1, 2);
+
+    // starts where the head is and seeks once into the next track
+    rc = P2_DiskWrite(0, 2, USLOSS_DISK_TRACK_SIZE - 2, 4, buffer);
+    TEST(rc, P1_SUCCESS);
+    Check(2, 2, 3);
+
+    rc = P2_DiskRead(0, 5, 0, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+    Check(3, 2, 5);
+
+    // a multi-track read back to the start, one seek per track
+    rc = P2_DiskRead(0, 0, USLOSS_DISK_TRACK_SIZE - 1, 2, buffer);
+    TEST(rc, P1_SUCCESS);
+    Check(5, 2, 11);
+
+    TEST(P2_DiskSeekStats(5, &i, &e, &t), P1_INVALID_UNIT);
+    TEST(P2_DiskSeekStats(0, NULL, &e, &t), P2_NULL_ADDRESS);
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
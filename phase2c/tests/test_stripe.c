@@ -0,0 +1,84 @@
+/*
+ * test_stripe.c
+ *
+ * Writes a run of logical sectors to the striped virtual disk, reads it back, and
+ * checks that the stripes landed on alternating units.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define STRIPE 4
+#define NUM_SECTORS (5*STRIPE + 2)
+
+static int passed = FALSE;
+
+static char buffer[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+static char check[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, i, size, stripe;
+
+    rc = P2DiskSetStripe(STRIPE);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    rc = P2_StripeSize(&size, &stripe);
+    TEST(rc, P1_SUCCESS);
+    TEST(stripe, STRIPE);
+    TEST(size, 2 * 10 * USLOSS_DISK_TRACK_SIZE);
+
+    for (i = 0; i < NUM_SECTORS; i++) {
+        memset(buffer + i*USLOSS_DISK_SECTOR_SIZE, 'A' + i, USLOSS_DISK_SECTOR_SIZE);
+    }
+    // start partway into a stripe
+    rc = P2_StripeWrite(1, NUM_SECTORS, buffer);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_StripeRead(1, NUM_SECTORS, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+
+    // logical sectors 4..7 are stripe 1, the first stripe on unit 1
+    rc = P2_DiskRead(1, 0, 0, STRIPE, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer + (STRIPE - 1)*USLOSS_DISK_SECTOR_SIZE, check, STRIPE*USLOSS_DISK_SECTOR_SIZE), 0);
+    // logical sectors 8..11 are stripe 2, the second stripe on unit 0
+    rc = P2_DiskRead(0, 0, STRIPE, STRIPE, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer + (2*STRIPE - 1)*USLOSS_DISK_SECTOR_SIZE, check, STRIPE*USLOSS_DISK_SECTOR_SIZE), 0);
+
+    TEST(P2_StripeRead(size, 1, check), P2_INVALID_FIRST);
+    TEST(P2_StripeRead(size - 1, 2, check), P2_INVALID_SECTORS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+    rc = Disk_Create(NULL, 1, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
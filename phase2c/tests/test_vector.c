@@ -0,0 +1,89 @@
+/*
+ * test_vector.c
+ *
+ * Writes and reads back segments on several tracks with single vectored calls.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_SEGMENTS 3
+
+static int passed = FALSE;
+
+static char buffers[NUM_SEGMENTS][2*USLOSS_DISK_SECTOR_SIZE];
+static char checks[NUM_SEGMENTS][2*USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, i;
+    int status[NUM_SEGMENTS + 1];
+    P2_DiskSegment segments[NUM_SEGMENTS + 1];
+    // deliberately out of track order, the last one crosses onto track 3
+    int tracks[NUM_SEGMENTS] = {7, 1, 2};
+    int firsts[NUM_SEGMENTS] = {4, 0, USLOSS_DISK_TRACK_SIZE - 1};
+
+    P2ClockInit();
+    // make the reads go to the disk
+    rc = P2DiskSetCacheSize(0);
+    TEST(rc, P1_SUCCESS);
+    P2DiskInit();
+
+    for (i = 0; i < NUM_SEGMENTS; i++) {
+        memset(buffers[i], 'a' + i, sizeof(buffers[i]));
+        segments[i].track = tracks[i];
+        segments[i].first = firsts[i];
+        segments[i].sectors = 2;
+        segments[i].buffer = buffers[i];
+    }
+    rc = P2_DiskWriteV(0, segments, NUM_SEGMENTS, status);
+    TEST(rc, P1_SUCCESS);
+    for (i = 0; i < NUM_SEGMENTS; i++) {
+        TEST(status[i], P1_SUCCESS);
+        segments[i].buffer = checks[i];
+    }
+
+    // one bad segment fails on its own without stopping the others
+    segments[NUM_SEGMENTS].track = 1000;
+    segments[NUM_SEGMENTS].first = 0;
+    segments[NUM_SEGMENTS].sectors = 1;
+    segments[NUM_SEGMENTS].buffer = checks[0];
+    rc = P2_DiskReadV(0, segments, NUM_SEGMENTS + 1, status);
+    TEST(rc, P2_INVALID_TRACK);
+    TEST(status[NUM_SEGMENTS], P2_INVALID_TRACK);
+    for (i = 0; i < NUM_SEGMENTS; i++) {
+        TEST(status[i], P1_SUCCESS);
+        TEST(memcmp(buffers[i], checks[i], sizeof(buffers[i])), 0);
+    }
+
+    TEST(P2_DiskReadV(0, segments, 0, status), P2_INVALID_SECTORS);
+    TEST(P2_DiskReadV(0, NULL, 1, status), P2_NULL_ADDRESS);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * test_writeback.c
+ *
+ * Writes with write-back caching on, flushes, and reads the sectors back from the
+ * disk itself with a vectored read, which always goes through the driver. Then
+ * overwrites a dirty sector with a vectored write, which the later reads must see.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <usloss.h>
+#include <phase1.h>
+#include <assert.h>
+#include <libuser.h>
+#include <libdisk.h>
+
+#include "tester.h"
+#include "phase2Ext.h"
+
+#define NUM_SECTORS 20
+
+static int passed = FALSE;
+
+static char buffer[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+static char check[NUM_SECTORS*USLOSS_DISK_SECTOR_SIZE];
+
+int P2_Startup(void *arg)
+{
+    int rc, status;
+    P2_DiskSegment segment;
+
+    rc = P2DiskSetWriteBack(TRUE);
+    TEST(rc, P1_SUCCESS);
+    P2ClockInit();
+    P2DiskInit();
+
+    // two overlapping writes, the second must win
+    memset(buffer, 'x', sizeof(buffer));
+    rc = P2_DiskWrite(0, 1, 5, NUM_SECTORS, buffer);
+    TEST(rc, P1_SUCCESS);
+    memset(buffer, 'y', USLOSS_DISK_SECTOR_SIZE);
+    rc = P2_DiskWrite(0, 1, 5, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+
+    rc = P2_DiskFlush(0);
+    TEST(rc, P1_SUCCESS);
+    TEST(P2_DiskFlush(5), P1_INVALID_UNIT);
+
+    segment.track = 1;
+    segment.first = 5;
+    segment.sectors = NUM_SECTORS;
+    segment.buffer = check;
+    rc = P2_DiskReadV(0, &segment, 1, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, sizeof(buffer)), 0);
+
+    // a vectored write goes to the driver, but must still replace the dirty block
+    memset(buffer, 'a', USLOSS_DISK_SECTOR_SIZE);
+    rc = P2_DiskWrite(0, 3, 0, 1, buffer);
+    TEST(rc, P1_SUCCESS);
+    memset(buffer, 'b', USLOSS_DISK_SECTOR_SIZE);
+    segment.track = 3;
+    segment.first = 0;
+    segment.sectors = 1;
+    segment.buffer = buffer;
+    rc = P2_DiskWriteV(0, &segment, 1, &status);
+    TEST(rc, P1_SUCCESS);
+    rc = P2_DiskRead(0, 3, 0, 1, check);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, USLOSS_DISK_SECTOR_SIZE), 0);
+    rc = P2_DiskFlush(0);
+    TEST(rc, P1_SUCCESS);
+    segment.buffer = check;
+    memset(check, 0, USLOSS_DISK_SECTOR_SIZE);
+    rc = P2_DiskReadV(0, &segment, 1, &status);
+    TEST(rc, P1_SUCCESS);
+    TEST(memcmp(buffer, check, USLOSS_DISK_SECTOR_SIZE), 0);
+
+    P2DiskShutdown();
+    P2ClockShutdown();
+    PASSED();
+    return 0;
+}
+
+void test_setup(int argc, char **argv) {
+    int rc;
+
+    rc = Disk_Create(NULL, 0, 10);
+    assert(rc == 0);
+}
+
+void test_cleanup(int argc, char **argv) {
+    DeleteAllDisks();
+    if (passed) {
+        USLOSS_Console("TEST PASSED.\n");
+    }
+}